@@ -0,0 +1,604 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exec.h"
+
+// SPMD batch mode
+//
+// runs one verified program over many inputs at once.  each VM instance is a
+// lane and memory is laid out so one cell holds that cell of every lane, so
+// the stack operations and ALU work on all lanes at once using the GCC
+// vector extensions.
+//
+// lanes sharing a program counter, stack pointer and frame pointer form a
+// group which executes together, masking off the lanes outside it.  a
+// conditional jump or return the lanes of a group disagree on splits it in
+// two.  the group running is the one in the deepest frame with the lowest
+// code position and groups which end up in the same place are merged again,
+// which for structured code is where the paths rejoin.
+//
+// each lane reads its input file as stdin and writes its stdout to the file
+// with '.out' appended.  errors end just the lane they happen in.
+
+// 4 lanes of 32 bit cells fill an SSE register, the x86-64 baseline
+#define NLANES 4
+
+typedef int bvec_t __attribute__((vector_size(4 * NLANES)));
+
+typedef struct {
+  int      ip;              // decoded instruction
+  int      sp;              // stack pointer
+  int      fp;              // frame pointer
+  int      st;              // string table
+  unsigned mask;            // lanes in the group
+  bvec_t   vmask;           // the same with all bits set for each lane
+} bgroup_t;
+
+bvec_t  *bMem;              // memory of all lanes, cell by cell
+bgroup_t bGroup[NLANES];    // groups of lanes running together
+int      bGroups;           // number of groups
+
+unsigned bLive;             // lanes still running
+int      bCode[NLANES];     // exit code of each lane
+char    *bName[NLANES];     // input file of each lane
+FILE    *bIn  [NLANES];     // stdin of each lane
+FILE    *bOut [NLANES];     // stdout of each lane
+
+bool     bTarget[NDECODED]; // where groups may meet up again
+
+#define LANES(L, G)                            \
+  for (int L=0; L<NLANES; ++L)                 \
+    if ((G)->mask & (1u << L))
+
+bvec_t bMask(unsigned mask) {
+  bvec_t v;
+  for (int l=0; l<NLANES; ++l) {
+    v[l] = (mask & (1u << l)) ? -1 : 0;
+  }
+  return v;
+}
+
+// store 'v' into cell 'c' for the lanes of 'g' only
+void bSet(bgroup_t *g, int c, bvec_t v) {
+  bMem[c] = (v & g->vmask) | (bMem[c] & ~g->vmask);
+}
+
+bvec_t bSplat(int v) {
+  bvec_t zero = { 0 };
+  return zero + v;
+}
+
+void bNew(int ip, int sp, int fp, int st, unsigned mask) {
+  bgroup_t *g = &bGroup[bGroups++];
+  g->ip    = ip;
+  g->sp    = sp;
+  g->fp    = fp;
+  g->st    = st;
+  g->mask  = mask;
+  g->vmask = bMask(mask);
+}
+
+// finish lane 'l' of group 'g' with exit code 'code'
+void bEnd(bgroup_t *g, int l, int code) {
+  fflush(bOut[l]);
+  bCode[l] = code;
+  bLive   &= ~(1u << l);
+  g->mask &= ~(1u << l);
+  g->vmask = bMask(g->mask);
+}
+
+// end lane 'l' of group 'g' with an error
+void bFail(bgroup_t *g, int l, char *msg, ...) {
+  va_list args;
+  va_start(args, msg);
+  fprintf(stderr, "%s: ", bName[l]);
+  vfprintf(stderr, msg, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  bEnd(g, l, 1);
+}
+
+void bPrintStr(int l, int addr) {
+  int c;
+  while ((unsigned)addr < NMEMORY && (c = bMem[addr++][l])) {
+    fputc(c, bOut[l]);
+  }
+}
+
+// system call 'opr' for lane 'l' of group 'g', as vInsScall
+void bScall(bgroup_t *g, int l, int opr) {
+  int sp    = g->sp;
+  int nargs = bMem[--sp][l];
+  int ret   = 0;
+  FILE *out = bOut[l];
+
+  switch (opr) {
+  case 0:
+    fputc(bMem[sp - 1][l], out);
+    break;
+  case 1:
+    bPrintStr(l, bMem[sp - 1][l]);
+    break;
+  case 2: {
+    if (nargs == 0) {
+      bFail(g, l, "error: insufficient arguments to printf");
+      return;
+    }
+    int n   = nargs;
+    int fmt = bMem[sp - n--][l];
+    bool mod = false;
+    char c;
+    while ((c = bMem[fmt++][l])) {
+      if (mod) {
+        if (n <= 0) {
+          bFail(g, l, "error: insufficient arguments to printf");
+          return;
+        }
+        int val = bMem[sp - n--][l];
+        switch (c) {
+        case 'd': fprintf(out, "%d", val); break;
+        case 'u': fprintf(out, "%u", val); break;
+        case 'c': fprintf(out, "%c", val); break;
+        case 's': bPrintStr(l, val);       break;
+        }
+        mod = false;
+      }
+      else if (c == '%') {
+        mod = true;
+      }
+      else {
+        fputc(c, out);
+      }
+    }
+    break;
+  }
+  case 3:
+    ret = fgetc(bIn[l]);
+    break;
+  case 4:
+    bEnd(g, l, bMem[sp - 1][l]);
+    return;
+  default:
+    bFail(g, l, "error: unknown systemcall");
+    return;
+  }
+  sp -= vScallPops(opr, nargs);
+  bMem[sp][l] = ret;
+}
+
+// split the lanes of 'g' in 'taken' off to continue at 'to'
+void bBranch(bgroup_t *g, unsigned taken, int to) {
+  taken &= g->mask;
+  if (taken == g->mask) {
+    g->ip = to;
+  }
+  else if (taken) {
+    bNew(to, g->sp, g->fp, g->st, taken);
+    g->mask &= ~taken;
+    g->vmask = bMask(g->mask);
+  }
+}
+
+// run group 'g' until the groups need scheduling again
+void bRunGroup(bgroup_t *g) {
+
+  bool first = true;
+  while (g->mask) {
+
+    // let other groups catch up and merge
+    if (bGroups > 1 && bTarget[g->ip] && !first) {
+      return;
+    }
+    first = false;
+
+    int     ins = vDecIns[g->ip];
+    int     opr = vDec[g->ip].opr;
+    int     sp  = g->sp;
+    bvec_t  lhs, rhs, res;
+    ++g->ip;
+
+#define TOP       bMem[sp - 1]
+#define UNDER     bMem[sp - 2]
+#define PUSH(V)   (bSet(g, sp, (V)), g->sp = ++sp)
+#define BINOP(E)  (lhs = UNDER, rhs = TOP, res = (E), bSet(g, sp - 2, res), g->sp = --sp)
+
+    switch (ins) {
+    case INS_DEREF:
+      LANES(l, g) {
+        int a = TOP[l];
+        if (a < 0 || a >= sp - 1) {
+          bFail(g, l, "error: invalid dereference");
+          continue;
+        }
+        TOP[l] = bMem[a][l];
+      }
+      break;
+    case INS_DROP:    g->sp = --sp;                                     break;
+    case TOK_LOGNOT:  bSet(g, sp - 1, (TOP == 0) & 1);                  break;
+    case INS_NEG:     bSet(g, sp - 1, -TOP);                            break;
+    case TOK_ASSIGN:
+      LANES(l, g) {
+        int a = UNDER[l];
+        if (a < 0 || a >= sp - 2) {
+          bFail(g, l, "error: invalid lvalue address");
+          continue;
+        }
+        bMem[a][l] = TOP[l];
+        UNDER[l]   = TOP[l];
+      }
+      g->sp = --sp;
+      break;
+    case INS_INDEX:
+      LANES(l, g) {
+        int a = UNDER[l] + TOP[l];
+        if (a < 0 || a >= sp - 2) {
+          bFail(g, l, "error: invalid dereference");
+          continue;
+        }
+        UNDER[l] = bMem[a][l];
+      }
+      g->sp = --sp;
+      break;
+    case INS_STOREX:
+      LANES(l, g) {
+        int a = bMem[sp - 3][l] + UNDER[l];
+        if (a < 0 || a >= sp - 3) {
+          bFail(g, l, "error: invalid lvalue address");
+          continue;
+        }
+        bMem[a][l]      = TOP[l];
+        bMem[sp - 3][l] = TOP[l];
+      }
+      g->sp = sp -= 2;
+      break;
+    case INS_SELECT:
+      res = bMem[sp - 3] != 0;
+      bSet(g, sp - 3, (UNDER & res) | (TOP & ~res));
+      g->sp = sp -= 2;
+      break;
+    case INS_ADDASSIGN:
+      LANES(l, g) {
+        int a = UNDER[l];
+        if (a < 0 || a >= sp - 2) {
+          bFail(g, l, "error: invalid lvalue address");
+          continue;
+        }
+        bMem[a][l] += TOP[l];
+        UNDER[l]    = bMem[a][l];
+      }
+      g->sp = --sp;
+      break;
+    case TOK_ADD:     BINOP(lhs + rhs);                                 break;
+    case TOK_SUB:     BINOP(lhs - rhs);                                 break;
+    case TOK_MUL:     BINOP(lhs * rhs);                                 break;
+    case TOK_BITOR:   BINOP(lhs | rhs);                                 break;
+    case TOK_BITAND:  BINOP(lhs & rhs);                                 break;
+    case TOK_BITXOR:  BINOP(lhs ^ rhs);                                 break;
+    case TOK_SHL:     BINOP(lhs << (rhs & 31));                         break;
+    case TOK_SHR:     BINOP(lhs >> (rhs & 31));                         break;
+    case TOK_LOGOR:   BINOP(((lhs | rhs) != 0) & 1);                    break;
+    case TOK_LOGAND:  BINOP(((lhs != 0) & (rhs != 0)) & 1);             break;
+    case TOK_LT:      BINOP((lhs <  rhs) & 1);                          break;
+    case TOK_GT:      BINOP((lhs >  rhs) & 1);                          break;
+    case TOK_LTEQU:   BINOP((lhs <= rhs) & 1);                          break;
+    case TOK_GTEQU:   BINOP((lhs >= rhs) & 1);                          break;
+    case TOK_EQU:     BINOP((lhs == rhs) & 1);                          break;
+    case TOK_NEQU:    BINOP((lhs != rhs) & 1);                          break;
+    case TOK_DIV:
+    case TOK_MOD:
+      LANES(l, g) {
+        if (TOP[l] == 0) {
+          bFail(g, l, "error: division by zero");
+        }
+      }
+      // lanes not taking part divide by one so they can't trap
+      lhs = UNDER;
+      rhs = (TOP & g->vmask) | (bSplat(1) & ~g->vmask);
+      res = (ins == TOK_DIV) ? lhs / rhs : lhs % rhs;
+      bSet(g, sp - 2, res);
+      g->sp = --sp;
+      break;
+    case INS_DUP:     PUSH(TOP);                                        break;
+    case INS_SWAP:
+      lhs = UNDER;
+      bSet(g, sp - 2, TOP);
+      bSet(g, sp - 1, lhs);
+      break;
+    case INS_STRTAB:  g->st = opr;                                      break;
+    case INS_STR:     PUSH(bSplat(g->st + opr));                        break;
+    case INS_CONST:   PUSH(bSplat(opr));                                break;
+    case INS_GETAG:   PUSH(bSplat(vStackBase + opr));                   break;
+    case INS_GETAL:   PUSH(bSplat(g->fp + opr));                        break;
+    case INS_GETAA:   PUSH(bSplat(g->fp - opr - FRAMESIZE));            break;
+    // the verifier proved variable accesses in range, globals are absolute
+    case INS_LOADL:   PUSH(bMem[g->fp + opr]);                          break;
+    case INS_STOREL:  bSet(g, g->fp + opr, TOP);                        break;
+    case INS_LOADA:   PUSH(bMem[g->fp - opr - FRAMESIZE]);              break;
+    case INS_STOREA:  bSet(g, g->fp - opr - FRAMESIZE, TOP);            break;
+    case INS_LOADG:   PUSH(bMem[opr]);                                  break;
+    case INS_STOREG:  bSet(g, opr, TOP);                                break;
+    case INS_INCL:
+    case INS_INCA:
+    case INS_INCG: {
+      int a = INC_SLOT(opr);
+      a = (ins == INS_INCL) ? g->fp + a :
+          (ins == INS_INCA) ? g->fp - a - FRAMESIZE : vStackBase + a;
+      res = bMem[a] + INC_BY(opr);
+      bSet(g, a, res);
+      PUSH(res);
+      break;
+    }
+    case INS_ALLOC:
+    case INS_ENTER:
+      for (int i=0; i<opr; ++i) {
+        PUSH(bSplat(0));
+      }
+      break;
+    case INS_JMP:
+      g->ip = opr;
+      break;
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE: {
+      int pops = 2;
+      switch (ins) {
+      case INS_JZ:  res = TOP == 0;      pops = 1; break;
+      case INS_JNZ: res = TOP != 0;      pops = 1; break;
+      case INS_JLT: res = UNDER <  TOP;  break;
+      case INS_JGE: res = UNDER >= TOP;  break;
+      case INS_JEQ: res = UNDER == TOP;  break;
+      case INS_JNE: res = UNDER != TOP;  break;
+      case INS_JGT: res = UNDER >  TOP;  break;
+      default:      res = UNDER <= TOP;  break;
+      }
+      unsigned taken = 0;
+      LANES(l, g) {
+        if (res[l]) {
+          taken |= 1u << l;
+        }
+      }
+      g->sp = sp -= pops;
+      unsigned mask = g->mask;
+      bBranch(g, taken, opr);
+      if ((taken & mask) && (taken & mask) != mask) {
+        return;
+      }
+      break;
+    }
+    case INS_SWITCH: {
+      // lanes taking the same entry of the table stay together
+      int entry[NLANES];
+      LANES(l, g) {
+        entry[l] = ((unsigned)TOP[l] < (unsigned)opr) ? TOP[l] : opr;
+      }
+      g->sp = --sp;
+      unsigned mask = g->mask;
+      unsigned left = mask;
+      int at = g->ip;
+      while (left) {
+        int first = __builtin_ctz(left);
+        unsigned same = 0;
+        for (int l=first; l<NLANES; ++l) {
+          if ((left & (1u << l)) && entry[l] == entry[first]) {
+            same |= 1u << l;
+          }
+        }
+        left &= ~same;
+        bBranch(g, same, vDec[at + entry[first]].opr);
+      }
+      if (g->mask != mask) {
+        return;
+      }
+      break;
+    }
+    case INS_CALL:
+      if (sp > vDecLimit[opr]) {
+        LANES(l, g) {
+          bFail(g, l, "error: stack overflow");
+        }
+        return;
+      }
+      PUSH(bSplat(g->fp));
+      PUSH(bSplat(vDec[g->ip - 1].pc + 2));
+      g->ip = opr;
+      g->fp = sp;
+      break;
+    case INS_TAILCALL: {
+      int args = TAIL_ARGS(opr);
+      int base = g->fp - FRAMESIZE - TAIL_DROP(opr);
+      opr = TAIL_TO(opr);
+      if (base + args > vDecLimit[opr]) {
+        LANES(l, g) {
+          bFail(g, l, "error: stack overflow");
+        }
+        return;
+      }
+      bvec_t fps = bMem[g->fp - 2];
+      bvec_t pcs = bMem[g->fp - 1];
+      for (int k=0; k<args; ++k) {
+        bSet(g, base + k, bMem[sp - args + k]);
+      }
+      sp = base + args;
+      bSet(g, sp++, fps);
+      bSet(g, sp++, pcs);
+      g->sp = sp;
+      g->ip = opr;
+      g->fp = sp;
+      break;
+    }
+    case INS_RETURN: {
+      int fp = g->fp;
+      int to = fp - FRAMESIZE - opr + 1;
+      bvec_t pcs = bMem[fp - 1];
+      bvec_t fps = bMem[fp - 2];
+      bSet(g, to - 1, TOP);
+
+      // lanes may disagree where they return to if they wrote their frame
+      unsigned left = g->mask;
+      g->mask = 0;
+      while (left) {
+        int first = __builtin_ctz(left);
+        int pc    = pcs[first];
+        int ofp   = fps[first];
+        unsigned same = 0;
+        for (int l=first; l<NLANES; ++l) {
+          if ((left & (1u << l)) && pcs[l] == pc && fps[l] == ofp) {
+            same |= 1u << l;
+          }
+        }
+        left &= ~same;
+
+        bgroup_t tmp;
+        tmp.mask  = same;
+        tmp.vmask = bMask(same);
+        if (ofp <= vStackBase) {
+          LANES(l, &tmp) {
+            bEnd(&tmp, l, bMem[to - 1][l]);
+          }
+          continue;
+        }
+        if ((unsigned)pc >= (unsigned)vCodeEnd || vDecAt[pc] < 0) {
+          LANES(l, &tmp) {
+            bFail(&tmp, l, "error: invalid vPC 0x%08x", pc);
+          }
+          continue;
+        }
+        int i = vDecAt[pc];
+        if (vDecDepth[i] != to - ofp ||
+            ofp - FRAMESIZE > vDecLimit[vDecFunc[i]]) {
+          LANES(l, &tmp) {
+            bFail(&tmp, l, "error: corrupt stack frame");
+          }
+          continue;
+        }
+        if (!g->mask) {
+          g->ip    = i;
+          g->sp    = to;
+          g->fp    = ofp;
+          g->mask  = same;
+          g->vmask = tmp.vmask;
+        }
+        else {
+          bNew(i, to, ofp, g->st, same);
+        }
+      }
+      return;
+    }
+    case INS_SCALL: {
+      // the argument count is a constant so every lane agrees on it
+      int nargs = TOP[__builtin_ctz(g->mask)];
+      LANES(l, g) {
+        bScall(g, l, opr);
+      }
+      g->sp = sp - 1 - vScallPops(opr, nargs) + 1;
+      break;
+    }
+    default:
+      LANES(l, g) {
+        bFail(g, l, "error: unknown instruction %u", ins);
+      }
+      return;
+    }
+
+#undef TOP
+#undef UNDER
+#undef PUSH
+#undef BINOP
+  }
+}
+
+// drop empty groups, merge groups which met up and pick the next to run
+bgroup_t *bSchedule() {
+
+  for (int i=0; i<bGroups; ++i) {
+    bgroup_t *a = &bGroup[i];
+    for (int j=i+1; j<bGroups && a->mask; ++j) {
+      bgroup_t *b = &bGroup[j];
+      if (a->ip == b->ip && a->sp == b->sp &&
+          a->fp == b->fp && a->st == b->st) {
+        a->mask |= b->mask;
+        a->vmask = bMask(a->mask);
+        b->mask  = 0;
+      }
+    }
+  }
+
+  int n = 0;
+  for (int i=0; i<bGroups; ++i) {
+    if (bGroup[i].mask) {
+      bGroup[n++] = bGroup[i];
+    }
+  }
+  bGroups = n;
+
+  // the deepest frame first then the earliest code position
+  bgroup_t *best = NULL;
+  for (int i=0; i<bGroups; ++i) {
+    bgroup_t *g = &bGroup[i];
+    if (!best || g->fp > best->fp || (g->fp == best->fp && g->ip < best->ip)) {
+      best = g;
+    }
+  }
+  return best;
+}
+
+// run up to NLANES inputs together
+void bBatch(char **inputs, int lanes) {
+
+  bMem = calloc(NMEMORY, sizeof(bvec_t));
+  if (!bMem) {
+    fatal("error: out of memory");
+  }
+  for (int c=0; c<cCodeLen; ++c) {
+    bMem[c] = bSplat(cCode[c]);
+  }
+
+  for (int l=0; l<lanes; ++l) {
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.out", inputs[l]);
+    bName[l] = inputs[l];
+    bIn  [l] = fopen(inputs[l], "r");
+    bOut [l] = fopen(path, "w");
+    if (!bIn[l] || !bOut[l]) {
+      fatal("error: unable to open '%s'", bIn[l] ? path : inputs[l]);
+    }
+    bCode[l] = 0;
+  }
+
+  bLive   = (1u << lanes) - 1;
+  bGroups = 0;
+  bNew(vDecAt[0], vStackBase, 0, 0, bLive);
+
+  while (bLive) {
+    bRunGroup(bSchedule());
+  }
+
+  for (int l=0; l<lanes; ++l) {
+    fclose(bIn [l]);
+    fclose(bOut[l]);
+    printf("%s %d\n", bName[l], bCode[l] & 0xff);
+  }
+  free(bMem);
+}
+
+// run the verified program over every input, printing each exit code
+void bRun(char **inputs, int count) {
+
+  vTargets(bTarget);
+  for (int i=1; i<vDecLen; ++i) {
+    if (vDecIns[i - 1] == INS_CALL) {
+      bTarget[i] = true;
+    }
+  }
+
+  for (int i=0; i<count; i+=NLANES) {
+    bBatch(inputs + i, (count - i < NLANES) ? count - i : NLANES);
+  }
+}
@@ -29,10 +29,26 @@
 #define TOK_BITNOT  26        // ~
 #define TOK_LBRACK  27        // [
 #define TOK_RBRACK  28        // ]
+#define TOK_BITXOR  29        // ^
+#define TOK_SHL     30        // <<
+#define TOK_SHR     31        // >>
 
 #define TOK_SYMBOL  32
 #define TOK_INTLIT  33        // integer literal
 #define TOK_STRLIT  34        // string literal
+#define TOK_COLON   35        // :
+
+#define TOK_ADDASSIGN 36      // +=
+#define TOK_SUBASSIGN 37      // -=
+#define TOK_MULASSIGN 38      // *=
+#define TOK_DIVASSIGN 39      // /=
+#define TOK_MODASSIGN 40      // %=
+#define TOK_ORASSIGN  41      // |=
+#define TOK_ANDASSIGN 42      // &=
+#define TOK_XORASSIGN 43      // ^=
+#define TOK_SHLASSIGN 44      // <<=
+#define TOK_SHRASSIGN 45      // >>=
+#define TOK_QUESTION  46      // ?
 
 #define TOK_IF        64  + 0   // if
 #define TOK_INT       64  + 1   // int
@@ -45,6 +61,9 @@
 #define TOK_FOR       64  + 8   // for
 #define TOK_BREAK     64  + 9   // break
 #define TOK_CONTINUE  64  + 10  // continue
+#define TOK_SWITCH    64  + 11  // switch
+#define TOK_CASE      64  + 12  // case
+#define TOK_DEFAULT   64  + 13  // default
 
 #define INS_DEREF   128 + 0   // dereference
 #define INS_CONST   128 + 1   // constant
@@ -52,7 +71,7 @@
 #define INS_GETAG   128 + 3   // get address of global
 #define INS_GETAL   128 + 4   // get address of local
 #define INS_GETAA   128 + 5   // get address of argument
-#define INS_ALLOC   128 + 6   // allocate space for locals
+#define INS_ALLOC   128 + 6   // allocate space for globals
 #define INS_RETURN  128 + 7   // return from function
 #define INS_JMP     128 + 8   // jump unconditional
 #define INS_JZ      128 + 9   // jump if zero
@@ -60,12 +79,47 @@
 #define INS_DROP    128 + 11  // drop top of stack
 #define INS_SCALL   128 + 12  // system call
 #define INS_NEG     128 + 13  // unary minus
-#define INS_INDEX   128 + 14  // array subscript
+#define INS_INDEX   128 + 14  // indexed load
 #define INS_DUP     128 + 15  // duplicate
 #define INS_SWAP    128 + 16  // swap top items on the stack
 #define INS_STRTAB  128 + 17  // set string table location
 #define INS_STR     128 + 18  // get address of string
 #define INS_LINE    128 + 19  // source code line
+#define INS_LOADL   128 + 20  // load local
+#define INS_STOREL  128 + 21  // store local
+#define INS_LOADA   128 + 22  // load argument
+#define INS_STOREA  128 + 23  // store argument
+#define INS_LOADG   128 + 24  // load global
+#define INS_STOREG  128 + 25  // store global
+#define INS_JLT     128 + 26  // compare and jump if less
+#define INS_JGE     128 + 27  // compare and jump if greater or equal
+#define INS_JEQ     128 + 28  // compare and jump if equal
+#define INS_JNE     128 + 29  // compare and jump if not equal
+#define INS_JGT     128 + 30  // compare and jump if greater
+#define INS_JLE     128 + 31  // compare and jump if less or equal
+#define INS_INCL    128 + 32  // add constant to local
+#define INS_INCA    128 + 33  // add constant to argument
+#define INS_INCG    128 + 34  // add constant to global
+#define INS_ADDASSIGN 128 + 35  // add to address
+#define INS_STOREX  128 + 36  // indexed store
+#define INS_SWITCH  128 + 37  // jump through the table of JMPs that follows
+#define INS_SELECT  128 + 38  // pick one of two values by a condition
+#define INS_TAILCALL 128 + 39 // call reusing the frame of the caller
+#define INS_ENTER   128 + 40  // allocate the locals of a function
+
+// the operand of the increment instructions packs the slot into the low 16
+// bits and a signed 16 bit constant into the high 16 bits
+#define INC_OPR(slot, k)  ((int)((unsigned)(k) << 16 | (slot)))
+#define INC_SLOT(opr)     ((opr) & 0xffff)
+#define INC_BY(opr)       ((opr) >> 16)
+
+// the operand of a tail call packs the target into the low 16 bits, the
+// argument count of the callee into the next 8 and of the caller into the
+// high 8
+#define TAIL_OPR(to, args, drop)  ((int)((unsigned)(drop) << 24 | (args) << 16 | (to)))
+#define TAIL_TO(opr)      ((opr) & 0xffff)
+#define TAIL_ARGS(opr)    (((opr) >> 16) & 0xff)
+#define TAIL_DROP(opr)    (((unsigned)(opr) >> 24) & 0xff)
 
 #define NFUNC       32
 #define NGLOBAL     32
@@ -74,8 +128,12 @@
 #define SYMTABLEN   (1024*4)
 #define NCODELEN    (1024*4)
 #define NSTRTABLEN  (1024*4)
-#define NBREAKS     8
+#define NBREAKS     64
 #define NCONTINUES  8
+#define NCASES      256
+#define NTAILCALLS  32
+#define NCONSTS     32
+#define NLOOPCOPY   256
 #define NLINES      1024
 
 #define token_t     int
@@ -86,8 +144,12 @@
 #define true        1
 #define false       0
 
-void  fatal   (char *msg, ...);
+void  fatal   (char *msg, ...) __attribute__((noreturn));
 int   dasm    (int *cCode, int loc);
+int   insSize (int ins);
+bool  insFold (int ins, int lhs, int rhs, int *res);
+char *insName (int ins);
+char *insSymbol(int ins);
 
 bool  strMatch(char *a, char *b);
 char *strSkip (char *c);
@@ -1,322 +1,1347 @@
-#include <stdarg.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#include "defs.h"
-
-#define NMEMORY 1024*1024
-
-#define FRAMESIZE 2         // old FP, PC
-
-int cCode[NMEMORY];         // code stream
-int cCodeLen;               // code length
-
-int *vStack = cCode;
-int vStackBase;             // bottom of stack
-int vStackPtr;              // stack pointer
-
-int vPC;                    // program counter
-int vFP;                    // frame pointer
-int vST;                    // string table
-
-int vPeek(int b) {
-  return vStack[vStackPtr - (1 + b)];
-}
-
-void vPush(int v) {
-  if (vStackPtr >= NMEMORY) {
-    fatal("error: stack overflow");
-  }
-  vStack[vStackPtr++] = v;
-}
-
-int vPop() {
-  if (vStackPtr <= 0) {
-    fatal("error: stack underflow");
-  }
-  return vStack[--vStackPtr];
-}
-
-void vInsDeref() {
-  int ptr = vPop();
-  if (ptr < 0 || ptr >= vStackPtr) {
-    fatal("error: invalid dereference");
-  }
-  vPush(vStack[ptr]);
-}
-
-void vInsAlu(int ins) {
-  int rhs = vPop();
-  int lhs = vPop();
-  int res = 0;
-
-  switch (ins) {
-  case TOK_MOD:
-  case TOK_DIV:
-    if (rhs == 0) {
-      fatal("error: division by zero");
-    }
-  }
-
-  switch (ins) {
-  case TOK_ADD:     res = lhs +  rhs; break;
-  case TOK_SUB:     res = lhs -  rhs; break;
-  case TOK_MUL:     res = lhs *  rhs; break;
-  case TOK_EQU:     res = lhs == rhs; break;
-  case TOK_NEQU:    res = lhs != rhs; break;
-  case TOK_LOGOR:   res = lhs || rhs; break;
-  case TOK_LOGAND:  res = lhs && rhs; break;
-  case TOK_BITOR:   res = lhs |  rhs; break;
-  case TOK_BITAND:  res = lhs &  rhs; break;
-
-  case TOK_DIV:     res = lhs /  rhs; break;
-  case TOK_MOD:     res = lhs %  rhs; break;
-
-  case TOK_LT:      res = lhs <  rhs; break;
-  case TOK_GT:      res = lhs >  rhs; break;
-  case TOK_LTEQU:   res = lhs <= rhs; break;
-  case TOK_GTEQU:   res = lhs >= rhs; break;
-  }
-  vPush(res);
-}
-
-void vInsAssign() {
-  int rvalue = vPop();
-  int lvalue = vPop();
-  if (lvalue < 0 || lvalue >= vStackPtr) {
-    fatal("error: invalid lvalue address");
-  }
-  vPush(vStack[lvalue] = rvalue);
-}
-
-void vInsCall(int opr) {
-  // save old stack frame
-  vPush(vFP);
-  // save return address (next inst)
-  vPush(vPC);
-  // jump to function
-  vPC = opr;
-  // start new stack frame
-  vFP = vStackPtr;
-}
-
-void vInsReturn(int opr) {
-  // pop return value
-  int ret = vPop();
-  // remove all locals
-  vStackPtr = vFP;
-  // pop return address
-  vPC = vPop();
-  // restore old stack frame
-  vFP = vPop();
-  // remove arguments
-  vStackPtr -= opr;
-  // place return value back on stack
-  vPush(ret);
-
-  if (vFP <= vStackBase) {
-    int ret = vPop();
-    exit(ret);
-  }
-}
-
-void vInsAlloc(int opr) {
-  if (vStackPtr >= NMEMORY) {
-    fatal("error: stack overflow");
-  }
-  // zero stack and enlarge
-  for (int i=0; i<opr; ++i) {
-    vStack[vStackPtr++] = 0;
-  }
-}
-
-void vPrintInt(const char *fmt, int value) {
-  printf(fmt, value);
-}
-
-void vPrintStr(int addr) {
-  int c;
-  while (c = vStack[addr++]) {
-    putchar(c);
-  }
-}
-
-void vSysPutchar(int opr, int nargs) {
-  (void)nargs;
-  putchar(vPop());
-  vPush(0);  // return value
-}
-
-void vSysPuts(int opr, int nargs) {
-  (void)nargs;
-  int addr = vPop();
-  vPrintStr(addr);
-  vPush(0);  // return value
-}
-
-void vSysPrintf(int opr, int n) {
-
-  if (n == 0) {
-    fatal("error: insufficient arguments to printf");
-  }
-  char c;
-  int nargs = n;
-  int fmt = vPeek(--n);
-
-  bool mod = false;
-  while (c = vStack[fmt++]) {
-    if (mod) {
-      if (n <= 0) {
-        fatal("error: insufficient arguments to printf");
-      }
-      int val = vPeek(--n);
-      switch (c) {
-      case 'd': vPrintInt("%d", val); break;
-      case 'u': vPrintInt("%u", val); break;
-      case 'c': vPrintInt("%c", val); break;
-      case 's': vPrintInt("%s", val); break;
-      }
-      mod = false;
-    } else {
-      if (c == '%') {
-        mod = true;
-      }
-      else {
-        putchar(c);
-      }
-    }
-  }
-  // pop all arguments
-  while (nargs--) {
-    vPop();
-  }
-  vPush(0);
-}
-
-void vSysGetchar() {
-  int r = getchar();
-  vPush(r);
-}
-
-void vSysExit() {
-  int code = vPop();
-  exit(code);
-  vPush(0);
-}
-
-void vInsScall(int opr) {
-
-  int nargs = vPop();
-
-  switch (opr) {
-  case 0: vSysPutchar(opr, nargs); break;
-  case 1: vSysPuts   (opr, nargs); break;
-  case 2: vSysPrintf (opr, nargs); break;
-  case 3: vSysGetchar(opr, nargs); break;
-  case 4: vSysExit   (opr, nargs); break;
-  default: fatal("error: unknown systemcall");
-  }
-}
-
-void vInsSwap() {
-  int x = vPop();
-  int y = vPop();
-  vPush(x);
-  vPush(y);
-}
-
-void vStep() {
-
-  if (vPC < 0 || vPC >= cCodeLen) {
-    fatal("error: invalid vPC 0x%08x", vPC);
-  }
-
-  int ins = cCode[ vPC++ ];
-
-  // zero operand instructions
-  switch (ins) {
-  case INS_DEREF:   vInsDeref();     return;
-  case INS_DROP:    vPop();          return;
-  case TOK_LOGNOT:  vPush(!vPop());  return;
-  case TOK_ASSIGN:  vInsAssign();    return;
-  case TOK_ADD:     vInsAlu(ins);    return;
-  case TOK_SUB:     vInsAlu(ins);    return;
-  case TOK_MUL:     vInsAlu(ins);    return;
-  case TOK_DIV:     vInsAlu(ins);    return;
-  case TOK_LOGOR:   vInsAlu(ins);    return;
-  case TOK_BITOR:   vInsAlu(ins);    return;
-  case TOK_LOGAND:  vInsAlu(ins);    return;
-  case TOK_BITAND:  vInsAlu(ins);    return;
-  case TOK_MOD:     vInsAlu(ins);    return;
-  case TOK_LT:      vInsAlu(ins);    return;
-  case TOK_GT:      vInsAlu(ins);    return;
-  case TOK_LTEQU:   vInsAlu(ins);    return;
-  case TOK_GTEQU:   vInsAlu(ins);    return;
-  case TOK_EQU:     vInsAlu(ins);    return;
-  case TOK_NEQU:    vInsAlu(ins);    return;
-  case INS_NEG:     vPush(-vPop());  return;
-  case INS_DUP:     vPush(vPeek(0)); return;
-  case INS_SWAP:    vInsSwap();      return;
-  }
-
-  int opr = cCode[ vPC++ ];
-
-  // one operand instructions
-  switch (ins) {
-  case INS_STRTAB:  vST = opr;                      return;
-  case INS_STR:     vPush(vST + opr);               return;
-  case INS_CONST:   vPush(opr);                     return;
-  case INS_CALL:    vInsCall(opr);                  return;
-  case INS_GETAG:   vPush(vStackBase + opr);        return;
-  case INS_GETAL:   vPush(vFP + opr);               return;
-  case INS_GETAA:   vPush(vFP - opr - FRAMESIZE);   return;
-  case INS_ALLOC:   vInsAlloc(opr);                 return;
-  case INS_RETURN:  vInsReturn(opr);                return;
-  case INS_JMP:                      vPC = opr;     return;
-  case INS_JZ:      if (vPop() == 0) vPC = opr;     return;
-  case INS_JNZ:     if (vPop() != 0) vPC = opr;     return;
-  case INS_SCALL:   vInsScall(opr);                 return;
-  case INS_LINE:                                    return;
-  }
-
-  fatal("error: unknown instruction %u", ins);
-}
-
-int main(int argc, char **args) {
-
-  FILE *fd = stdin;
-  if (argc > 1) {
-    fd = fopen(args[1], "r");
-  }
-  if (!fd) {
-    fatal("error: unable to open input file");
-  }
-
-  int trace = (argc > 2);
-
-  cCodeLen = fread(cCode, 4, NCODELEN, fd);
-  if (ferror(stdin)) {
-    fatal("error: fread error");
-  }
-
-  // start the stack after the code
-  vStackBase = cCodeLen;
-  vStackPtr  = cCodeLen;
-
-  // execution loop
-  int max_insts=-1;
-  while (--max_insts) {
-    if (trace) {
-      printf("%4d, %4d,  | ", vPeek(0), vPeek(1));
-      dasm(cCode + vPC, vPC);
-      printf("\n");
-    }
-    vStep();
-  }
-
-  if (max_insts <= 0) {
-    fatal("error: program did not complete");
-  }
-
-  return 0;
-}
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exec.h"
+
+int vMemory[1 + NMEMORY];   // guard cell, code stream and stack
+
+int *cCode = vMemory + 1;   // code stream
+int cCodeLen;               // code length
+
+int *vStack = vMemory + 1;
+int vStackBase;             // bottom of stack
+int vStackPtr;              // stack pointer
+
+int vPC;                    // program counter
+int vFP;                    // frame pointer
+int vST;                    // string table
+
+vdec_t vDec[NDECODED];      // decoded instruction stream
+int    vDecIns[NDECODED];   // opcode of each decoded instruction
+int    vDecLen;             // number of decoded instructions
+int    vDecAt[NCODELEN+1];  // code position to decoded index (-1 if none)
+void **vDecLabels;          // label table the handlers were taken from
+int    vCodeEnd;            // end of the instruction stream
+
+int    vDecDepth[NDECODED]; // verified stack depth on entry (-1 unreached)
+int    vDecFunc [NDECODED]; // function entry an instruction belongs to
+int    vDecArgs [NDECODED]; // function argument count (-1 never returns)
+int    vDecLimit[NDECODED]; // highest sp a function may be called with
+int    vDecWork [NDECODED]; // verifier work list
+int    vDecWorks;           // verifier work list size
+char  *vVerifyErr;          // reason verification failed
+int    vVerifyPc;           // code position verification failed at
+
+int    vHot  [NDECODED];    // backward jumps taken to each instruction
+long long vProfile[NDECODED]; // times each instruction was executed
+int    vSuper[NDECODED];    // superinstruction starting at each instruction
+
+// opcodes of each superinstruction, the first entry is unused
+const int vSuperSeq[][3] = {
+  { -1, -1, -1 },
+#define SUPER2(A, B)    { A, B, -1 },
+#define SUPER3(A, B, C) { A, B, C  },
+#include "vsuper.h"
+#undef SUPER2
+#undef SUPER3
+};
+
+#define NSUPER (int)(sizeof(vSuperSeq) / sizeof(vSuperSeq[0]))
+void  *vTrace[NDECODED];    // compiled trace for each loop header
+
+int vPeek(int b) {
+  return vStack[vStackPtr - (1 + b)];
+}
+
+void vPush(int v) {
+  if (vStackPtr >= NMEMORY) {
+    fatal("error: stack overflow");
+  }
+  vStack[vStackPtr++] = v;
+}
+
+int vPop() {
+  if (vStackPtr <= 0) {
+    fatal("error: stack underflow");
+  }
+  return vStack[--vStackPtr];
+}
+
+void vInsDeref() {
+  int ptr = vPop();
+  if (ptr < 0 || ptr >= vStackPtr) {
+    fatal("error: invalid dereference");
+  }
+  vPush(vStack[ptr]);
+}
+
+void vInsAlu(int ins) {
+  int rhs = vPop();
+  int lhs = vPop();
+  int res = 0;
+
+  switch (ins) {
+  case TOK_MOD:
+  case TOK_DIV:
+    if (rhs == 0) {
+      fatal("error: division by zero");
+    }
+  }
+
+  switch (ins) {
+  case TOK_ADD:     res = lhs +  rhs; break;
+  case TOK_SUB:     res = lhs -  rhs; break;
+  case TOK_MUL:     res = lhs *  rhs; break;
+  case TOK_EQU:     res = lhs == rhs; break;
+  case TOK_NEQU:    res = lhs != rhs; break;
+  case TOK_LOGOR:   res = lhs || rhs; break;
+  case TOK_LOGAND:  res = lhs && rhs; break;
+  case TOK_BITOR:   res = lhs |  rhs; break;
+  case TOK_BITAND:  res = lhs &  rhs; break;
+  case TOK_BITXOR:  res = lhs ^  rhs; break;
+  case TOK_SHL:     res = (int)((unsigned)lhs << (rhs & 31)); break;
+  case TOK_SHR:     res = lhs >> (rhs & 31); break;
+
+  case TOK_DIV:     res = lhs /  rhs; break;
+  case TOK_MOD:     res = lhs %  rhs; break;
+
+  case TOK_LT:      res = lhs <  rhs; break;
+  case TOK_GT:      res = lhs >  rhs; break;
+  case TOK_LTEQU:   res = lhs <= rhs; break;
+  case TOK_GTEQU:   res = lhs >= rhs; break;
+  }
+  vPush(res);
+}
+
+void vInsAssign() {
+  int rvalue = vPop();
+  int lvalue = vPop();
+  if (lvalue < 0 || lvalue >= vStackPtr) {
+    fatal("error: invalid lvalue address");
+  }
+  vPush(vStack[lvalue] = rvalue);
+}
+
+// push the variable at 'addr'
+void vInsLoad(int addr) {
+  if (addr < 0 || addr >= vStackPtr) {
+    fatal("error: invalid dereference");
+  }
+  vPush(vStack[addr]);
+}
+
+// store the top of stack to the variable at 'addr', leaving it on the stack
+void vInsStore(int addr) {
+  int rvalue = vPop();
+  if (addr < 0 || addr >= vStackPtr) {
+    fatal("error: invalid lvalue address");
+  }
+  vPush(vStack[addr] = rvalue);
+}
+
+// add 'k' to the variable at 'addr' and push the result
+void vInsInc(int addr, int k) {
+  if (addr < 0 || addr >= vStackPtr) {
+    fatal("error: invalid lvalue address");
+  }
+  vPush(vStack[addr] += k);
+}
+
+void vInsAddAssign() {
+  int rvalue = vPop();
+  int lvalue = vPop();
+  if (lvalue < 0 || lvalue >= vStackPtr) {
+    fatal("error: invalid lvalue address");
+  }
+  vPush(vStack[lvalue] += rvalue);
+}
+
+// store the top of stack to base plus index below it
+void vInsStoreIndex() {
+  int rvalue = vPop();
+  vInsAlu(TOK_ADD);
+  vPush(rvalue);
+  vInsAssign();
+}
+
+// pop a condition and two values and push the first if it holds
+void vInsSelect() {
+  int b = vPop();
+  int a = vPop();
+  vPush(vPop() ? a : b);
+}
+
+// pop two operands and compare them for a fused compare and jump
+bool vInsCompare(int ins) {
+  int rhs = vPop();
+  int lhs = vPop();
+  switch (ins) {
+  case INS_JLT: return lhs <  rhs;
+  case INS_JGE: return lhs >= rhs;
+  case INS_JEQ: return lhs == rhs;
+  case INS_JNE: return lhs != rhs;
+  case INS_JGT: return lhs >  rhs;
+  default:      return lhs <= rhs;
+  }
+}
+
+// jump to entry 'idx' of the table of 'n' JMPs after the switch, out of
+// range indices take the default entry which follows them
+void vInsSwitch(int n) {
+  unsigned idx = vPop();
+  vPC += 2 * ((idx < (unsigned)n) ? idx : (unsigned)n);
+}
+
+void vInsCall(int opr) {
+  // save old stack frame
+  vPush(vFP);
+  // save return address (next inst)
+  vPush(vPC);
+  // jump to function
+  vPC = opr;
+  // start new stack frame
+  vFP = vStackPtr;
+}
+
+// call replacing the frame of the current function, its arguments are
+// overwritten by those of the callee and the saved frame moved to follow them
+void vInsTailCall(int opr) {
+  int args = TAIL_ARGS(opr);
+  int base = vFP - FRAMESIZE - TAIL_DROP(opr);
+  if (vStackPtr < args || base < 0) {
+    fatal("error: invalid tail call");
+  }
+  int fp = vStack[vFP - 2];
+  int pc = vStack[vFP - 1];
+  for (int k=0; k<args; ++k) {
+    vStack[base + k] = vStack[vStackPtr - args + k];
+  }
+  vStackPtr = base + args;
+  vPush(fp);
+  vPush(pc);
+  vPC = TAIL_TO(opr);
+  vFP = vStackPtr;
+}
+
+void vInsReturn(int opr) {
+  // pop return value
+  int ret = vPop();
+  // remove all locals
+  vStackPtr = vFP;
+  // pop return address
+  vPC = vPop();
+  // restore old stack frame
+  vFP = vPop();
+  // remove arguments
+  vStackPtr -= opr;
+  // place return value back on stack
+  vPush(ret);
+
+  if (vFP <= vStackBase) {
+    int ret = vPop();
+    exit(ret);
+  }
+}
+
+void vInsAlloc(int opr) {
+  if (opr > NMEMORY - vStackPtr) {
+    fatal("error: stack overflow");
+  }
+  // zero stack and enlarge
+  if (opr > 0) {
+    memset(vStack + vStackPtr, 0, opr * sizeof(int));
+    vStackPtr += opr;
+  }
+}
+
+void vPrintInt(const char *fmt, int value) {
+  printf(fmt, value);
+}
+
+void vPrintStr(int addr) {
+  int c;
+  while (c = vStack[addr++]) {
+    putchar(c);
+  }
+}
+
+void vSysPutchar(int opr, int nargs) {
+  (void)nargs;
+  putchar(vPop());
+  vPush(0);  // return value
+}
+
+void vSysPuts(int opr, int nargs) {
+  (void)nargs;
+  int addr = vPop();
+  vPrintStr(addr);
+  vPush(0);  // return value
+}
+
+void vSysPrintf(int opr, int n) {
+
+  if (n == 0) {
+    fatal("error: insufficient arguments to printf");
+  }
+  char c;
+  int nargs = n;
+  int fmt = vPeek(--n);
+
+  bool mod = false;
+  while (c = vStack[fmt++]) {
+    if (mod) {
+      if (n <= 0) {
+        fatal("error: insufficient arguments to printf");
+      }
+      int val = vPeek(--n);
+      switch (c) {
+      case 'd': vPrintInt("%d", val); break;
+      case 'u': vPrintInt("%u", val); break;
+      case 'c': vPrintInt("%c", val); break;
+      case 's': vPrintInt("%s", val); break;
+      }
+      mod = false;
+    } else {
+      if (c == '%') {
+        mod = true;
+      }
+      else {
+        putchar(c);
+      }
+    }
+  }
+  // pop all arguments
+  while (nargs--) {
+    vPop();
+  }
+  vPush(0);
+}
+
+void vSysGetchar() {
+  int r = getchar();
+  vPush(r);
+}
+
+void vSysExit() {
+  int code = vPop();
+  exit(code);
+  vPush(0);
+}
+
+void vInsScall(int opr) {
+
+  int nargs = vPop();
+
+  switch (opr) {
+  case 0: vSysPutchar(opr, nargs); break;
+  case 1: vSysPuts   (opr, nargs); break;
+  case 2: vSysPrintf (opr, nargs); break;
+  case 3: vSysGetchar(opr, nargs); break;
+  case 4: vSysExit   (opr, nargs); break;
+  default: fatal("error: unknown systemcall");
+  }
+}
+
+// number of arguments a system call pops, -1 if unknown
+int vScallPops(int opr, int nargs) {
+  switch (opr) {
+  case 0:  return 1;
+  case 1:  return 1;
+  case 2:  return nargs;
+  case 3:  return 0;
+  case 4:  return 1;
+  default: return -1;
+  }
+}
+
+void vInsSwap() {
+  int x = vPop();
+  int y = vPop();
+  vPush(x);
+  vPush(y);
+}
+
+void vStep() {
+
+  if (vPC < 0 || vPC >= cCodeLen) {
+    fatal("error: invalid vPC 0x%08x", vPC);
+  }
+
+  int ins = cCode[ vPC++ ];
+
+  // zero operand instructions
+  switch (ins) {
+  case INS_DEREF:   vInsDeref();     return;
+  case INS_DROP:    vPop();          return;
+  case TOK_LOGNOT:  vPush(!vPop());  return;
+  case TOK_ASSIGN:  vInsAssign();    return;
+  case INS_ADDASSIGN: vInsAddAssign(); return;
+  case INS_INDEX:   vInsAlu(TOK_ADD);  vInsDeref();  return;
+  case INS_STOREX:  vInsStoreIndex(); return;
+  case INS_SELECT:  vInsSelect();    return;
+  case TOK_ADD:     vInsAlu(ins);    return;
+  case TOK_SUB:     vInsAlu(ins);    return;
+  case TOK_MUL:     vInsAlu(ins);    return;
+  case TOK_DIV:     vInsAlu(ins);    return;
+  case TOK_LOGOR:   vInsAlu(ins);    return;
+  case TOK_BITOR:   vInsAlu(ins);    return;
+  case TOK_LOGAND:  vInsAlu(ins);    return;
+  case TOK_BITAND:  vInsAlu(ins);    return;
+  case TOK_BITXOR:  vInsAlu(ins);    return;
+  case TOK_SHL:     vInsAlu(ins);    return;
+  case TOK_SHR:     vInsAlu(ins);    return;
+  case TOK_MOD:     vInsAlu(ins);    return;
+  case TOK_LT:      vInsAlu(ins);    return;
+  case TOK_GT:      vInsAlu(ins);    return;
+  case TOK_LTEQU:   vInsAlu(ins);    return;
+  case TOK_GTEQU:   vInsAlu(ins);    return;
+  case TOK_EQU:     vInsAlu(ins);    return;
+  case TOK_NEQU:    vInsAlu(ins);    return;
+  case INS_NEG:     vPush(-vPop());  return;
+  case INS_DUP:     vPush(vPeek(0)); return;
+  case INS_SWAP:    vInsSwap();      return;
+  }
+
+  int opr = cCode[ vPC++ ];
+
+  // one operand instructions
+  switch (ins) {
+  case INS_STRTAB:  vST = opr;                      return;
+  case INS_STR:     vPush(vST + opr);               return;
+  case INS_CONST:   vPush(opr);                     return;
+  case INS_CALL:    vInsCall(opr);                  return;
+  case INS_TAILCALL: vInsTailCall(opr);             return;
+  case INS_GETAG:   vPush(vStackBase + opr);        return;
+  case INS_GETAL:   vPush(vFP + opr);               return;
+  case INS_GETAA:   vPush(vFP - opr - FRAMESIZE);   return;
+  case INS_LOADL:   vInsLoad (vFP + opr);           return;
+  case INS_STOREL:  vInsStore(vFP + opr);           return;
+  case INS_LOADA:   vInsLoad (vFP - opr - FRAMESIZE); return;
+  case INS_STOREA:  vInsStore(vFP - opr - FRAMESIZE); return;
+  case INS_LOADG:   vInsLoad (vStackBase + opr);    return;
+  case INS_STOREG:  vInsStore(vStackBase + opr);    return;
+  case INS_INCL:    vInsInc(vFP + INC_SLOT(opr), INC_BY(opr));              return;
+  case INS_INCA:    vInsInc(vFP - INC_SLOT(opr) - FRAMESIZE, INC_BY(opr));  return;
+  case INS_INCG:    vInsInc(vStackBase + INC_SLOT(opr), INC_BY(opr));       return;
+  case INS_ALLOC:
+  case INS_ENTER:   vInsAlloc(opr);                 return;
+  case INS_RETURN:  vInsReturn(opr);                return;
+  case INS_JMP:                      vPC = opr;     return;
+  case INS_JZ:      if (vPop() == 0) vPC = opr;     return;
+  case INS_JNZ:     if (vPop() != 0) vPC = opr;     return;
+  case INS_JLT:
+  case INS_JGE:
+  case INS_JEQ:
+  case INS_JNE:
+  case INS_JGT:
+  case INS_JLE:     if (vInsCompare(ins)) vPC = opr; return;
+  case INS_SWITCH:  vInsSwitch(opr);                return;
+  case INS_SCALL:   vInsScall(opr);                 return;
+  case INS_LINE:                                    return;
+  }
+
+  fatal("error: unknown instruction %u", ins);
+}
+
+// append a decoded instruction
+int vDecAdd(int ins, int opr, int pc) {
+  vDecIns[vDecLen]     = ins;
+  vDec   [vDecLen].op  = NULL;
+  vDec   [vDecLen].opr = opr;
+  vDec   [vDecLen].pc  = pc;
+  return vDecLen++;
+}
+
+// map a jump target to a decoded index
+int vDecTarget(int pc) {
+  if (pc >= 0 && pc <= vCodeEnd && vDecAt[pc] >= 0) {
+    return vDecAt[pc];
+  }
+  // executing this will report the bad target
+  return vDecAdd(DEC_BADPC, pc, pc);
+}
+
+// translate the code stream into the decoded instruction stream
+//
+// line markers are dropped, jump and call targets become decoded indices and
+// operands which are constant for the whole run are resolved up front.  the
+// code stream itself is left untouched as it is also the bottom of the stack.
+void vDecode() {
+
+  // the string table follows the last instruction
+  vCodeEnd = cCodeLen;
+  if (cCodeLen >= 2 && cCode[0] == INS_STRTAB &&
+      cCode[1] >= 0 && cCode[1] <= cCodeLen) {
+    vCodeEnd = cCode[1];
+  }
+
+  int strtabs = 0;
+  int pc = 0;
+  while (pc < vCodeEnd) {
+    int ins  = cCode[pc];
+    int size = insSize(ins);
+    vDecAt[pc] = vDecLen;
+    if (size == 0 || pc + size > vCodeEnd) {
+      vDecAdd(DEC_BADINS, ins, pc);
+      pc += 1;
+      continue;
+    }
+    if (size == 2) {
+      vDecAt[pc + 1] = -1;
+    }
+    if (ins == INS_STRTAB) {
+      ++strtabs;
+    }
+    // an empty prologue does nothing
+    if (ins != INS_LINE && !(ins == INS_ENTER && cCode[pc + 1] == 0)) {
+      vDecAdd(ins, (size == 2) ? cCode[pc + 1] : 0, pc);
+    }
+    pc += size;
+  }
+
+  // running off the end is an error
+  vDecAt[vCodeEnd] = vDecAdd(DEC_BADPC, vCodeEnd, vCodeEnd);
+
+  // the string table is fixed if it is only set by the first instruction
+  bool strFixed = (strtabs == 1 && vDecIns[0] == INS_STRTAB);
+
+  int count = vDecLen;
+  for (int i=0; i<count; ++i) {
+    int *opr = &vDec[i].opr;
+    switch (vDecIns[i]) {
+    case INS_JMP:
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE:
+    case INS_CALL:
+      *opr = vDecTarget(*opr);
+      break;
+    case INS_TAILCALL:
+      *opr = TAIL_OPR(vDecTarget(TAIL_TO(*opr)), TAIL_ARGS(*opr), TAIL_DROP(*opr));
+      break;
+    case INS_GETAG:
+      vDecIns[i] = INS_CONST;
+      *opr += vStackBase;
+      break;
+    case INS_LOADG:
+    case INS_STOREG:
+      // global slots become absolute addresses
+      *opr += vStackBase;
+      break;
+    case INS_STR:
+      if (strFixed) {
+        vDecIns[i] = INS_CONST;
+        *opr += vDec[0].opr;
+      }
+      break;
+    }
+  }
+}
+
+bool vVerifyFail(char *why, int i) {
+  vVerifyErr = why;
+  vVerifyPc  = vDec[i].pc;
+  return false;
+}
+
+// find the argument count of the function starting at 'entry' by looking at
+// every return it can reach, or at the return ending it if it loops forever.
+// returns -1 if it has no return and -2 if the returns disagree.
+int vVerifyArgs(int entry) {
+  static int mark[NDECODED];
+  int nargs = -1;
+  vDecWorks = 0;
+  vDecWork[vDecWorks++] = entry;
+  mark[entry] = entry + 1;
+  while (vDecWorks) {
+    int i   = vDecWork[--vDecWorks];
+    int ins = vDecIns[i];
+    int opr = vDec[i].opr;
+    int next[2] = { i + 1, -1 };
+    switch (ins) {
+    case INS_TAILCALL:
+      // returns for the callee, which pops the same arguments
+      opr = TAIL_DROP(opr);
+      // fall through
+    case INS_RETURN:
+      if (nargs >= 0 && nargs != opr) {
+        return -2;
+      }
+      nargs = opr;
+      // fall through
+    case DEC_BADPC:
+    case DEC_BADINS:
+      next[0] = -1;
+      break;
+    case INS_JMP:
+      next[0] = opr;
+      break;
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE:
+      next[1] = opr;
+      break;
+    case INS_SWITCH:
+      // every entry of the table but the last, which follows
+      for (int n=i + 1; n<=i + opr && n < vDecLen; ++n) {
+        if (mark[n] != entry + 1) {
+          mark[n] = entry + 1;
+          vDecWork[vDecWorks++] = n;
+        }
+      }
+      next[0] = i + opr + 1;
+      break;
+    case INS_CALL:
+      // the bootstrap exits when main returns
+      if (entry == 0) {
+        next[0] = -1;
+      }
+      break;
+    }
+    for (int j=0; j<2; ++j) {
+      int n = next[j];
+      if (n >= 0 && n < vDecLen && mark[n] != entry + 1) {
+        mark[n] = entry + 1;
+        vDecWork[vDecWorks++] = n;
+      }
+    }
+  }
+  for (int i=entry; entry != 0 && nargs < 0 && i < vDecLen; ++i) {
+    if (vDecIns[i] == INS_RETURN) {
+      nargs = vDec[i].opr;
+    }
+  }
+  return nargs;
+}
+
+// record the stack depth on the edge from 'from' to 'to'
+bool vVerifyEdge(int from, int to, int depth) {
+  if (vDecIns[to] == DEC_BADPC) {
+    return vVerifyFail("invalid jump target", from);
+  }
+  if (vDecDepth[to] < 0) {
+    vDecDepth[to] = depth;
+    vDecFunc [to] = vDecFunc[from];
+    vDecWork[vDecWorks++] = to;
+    return true;
+  }
+  if (vDecDepth[to] != depth || vDecFunc[to] != vDecFunc[from]) {
+    return vVerifyFail("inconsistent stack depth", to);
+  }
+  return true;
+}
+
+// check the variable instruction 'i' of function 'f' accesses lies below
+// the 'top' cells of the stack the program owns.  'globals' is the end of
+// the globals the bootstrap allocated before calling into the program
+bool vVerifySlot(int i, int f, int top, int globals) {
+  int opr = vDec[i].opr;
+  bool ok = true;
+  switch (vDecIns[i]) {
+  case INS_LOADL:
+  case INS_STOREL:
+    ok = opr >= 0 && opr < top;
+    break;
+  case INS_LOADA:
+  case INS_STOREA:
+    ok = f != 0 && opr >= 1 && opr <= vDecArgs[f];
+    break;
+  case INS_LOADG:
+  case INS_STOREG:
+    ok = opr >= 0 && opr < ((f == 0) ? top : globals);
+    break;
+  case INS_INCL:
+    ok = INC_SLOT(opr) < top;
+    break;
+  case INS_INCA:
+    ok = f != 0 && INC_SLOT(opr) >= 1 && INC_SLOT(opr) <= vDecArgs[f];
+    break;
+  case INS_INCG:
+    ok = vStackBase + INC_SLOT(opr) < ((f == 0) ? top : globals);
+    break;
+  }
+  return ok || vVerifyFail("variable out of range", i);
+}
+
+// check the decoded program is well formed
+//
+// this is an abstract interpretation of every function tracking the stack
+// depth relative to the frame pointer.  a program passes if every jump lands
+// on an instruction, the depth agrees wherever control flow merges, nothing
+// pops into the frame, system calls have a constant argument count and every
+// return of a function pops the same number of arguments, which every call
+// site must have pushed.  on success vDecLimit holds the highest stack
+// pointer each function can safely be called with so the loop only needs to
+// check for overflow once per call.  the variable loads and stores must
+// address the frame, arguments or globals so they need no checks either.
+bool vVerify() {
+
+  for (int i=0; i<vDecLen; ++i) {
+    vDecDepth[i] = -1;
+    vDecArgs [i] = -1;
+  }
+
+  // every call target is a function entry
+  static int  entries[NDECODED];
+  static bool target [NDECODED];
+  int nentries = 0;
+  entries[nentries++] = 0;
+  for (int i=0; i<vDecLen; ++i) {
+    switch (vDecIns[i]) {
+    case INS_JMP:
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE:
+      target[vDec[i].opr] = true;
+      break;
+    case INS_SWITCH:
+      for (int k=1; k<=vDec[i].opr + 1 && i + k < vDecLen; ++k) {
+        target[i + k] = true;
+      }
+    }
+    if (vDecIns[i] != INS_CALL && vDecIns[i] != INS_TAILCALL) {
+      continue;
+    }
+    int f = (vDecIns[i] == INS_CALL) ? vDec[i].opr : TAIL_TO(vDec[i].opr);
+    if (vDecIns[f] == DEC_BADPC) {
+      return vVerifyFail("invalid call target", i);
+    }
+    if (contains(f, entries, nentries) < 0) {
+      entries[nentries++] = f;
+    }
+  }
+  for (int e=0; e<nentries; ++e) {
+    int f = entries[e];
+    if ((vDecArgs[f] = vVerifyArgs(f)) == -2) {
+      return vVerifyFail("return argument counts differ", f);
+    }
+  }
+  if (vDecArgs[0] >= 0) {
+    return vVerifyFail("return outside of a function", 0);
+  }
+
+  // the bootstrap is checked first and finds the end of the globals
+  int globals = NMEMORY;
+  for (int e=0; e<nentries; ++e) {
+    int f = entries[e];
+    if (vDecDepth[f] >= 0) {
+      return vVerifyFail("function entered by fall through", f);
+    }
+    // the bootstrap runs with a zero frame pointer
+    int maxDepth = (f == 0) ? vStackBase : 0;
+    vDecDepth[f] = maxDepth;
+    vDecFunc [f] = f;
+    vDecWorks = 0;
+    vDecWork[vDecWorks++] = f;
+
+    while (vDecWorks) {
+      int i   = vDecWork[--vDecWorks];
+      int ins = vDecIns[i];
+      int opr = vDec[i].opr;
+      int d   = vDecDepth[i];
+      int pop = 0;        // cells required on the stack
+      int out = 0;        // change in depth
+      int to  = -1;       // jump target
+      int table = 0;      // switch table entries following
+      bool falls = true;  // control reaches the next instruction
+
+      switch (ins) {
+      case INS_DEREF:
+      case INS_NEG:
+      case TOK_LOGNOT:  pop = 1; out =  0; break;
+      case INS_DROP:    pop = 1; out = -1; break;
+      case INS_STOREX:
+      case INS_SELECT:  pop = 3; out = -2; break;
+      case INS_DUP:     pop = 1; out =  1; break;
+      case INS_SWAP:    pop = 2; out =  0; break;
+      case TOK_ASSIGN:
+      case INS_ADDASSIGN:
+      case INS_INDEX:
+      case TOK_ADD:
+      case TOK_SUB:
+      case TOK_MUL:
+      case TOK_DIV:
+      case TOK_MOD:
+      case TOK_LOGOR:
+      case TOK_LOGAND:
+      case TOK_BITOR:
+      case TOK_BITAND:
+      case TOK_BITXOR:
+      case TOK_SHL:
+      case TOK_SHR:
+      case TOK_LT:
+      case TOK_GT:
+      case TOK_LTEQU:
+      case TOK_GTEQU:
+      case TOK_EQU:
+      case TOK_NEQU:    pop = 2; out = -1; break;
+      case INS_STRTAB:  break;
+      case INS_STR:
+      case INS_CONST:
+      case INS_GETAG:
+      case INS_GETAL:
+      case INS_GETAA:   out = 1; break;
+      case INS_LOADL:
+      case INS_LOADA:
+      case INS_LOADG:
+      case INS_INCL:
+      case INS_INCA:
+      case INS_INCG:    out = 1; break;
+      case INS_STOREL:
+      case INS_STOREA:
+      case INS_STOREG:  pop = 1; out = 0; break;
+      case INS_ALLOC:
+      case INS_ENTER:
+        if (opr < 0) {
+          return vVerifyFail("negative allocation", i);
+        }
+        out = opr;
+        break;
+      case INS_JMP:     to = opr; falls = false; break;
+      case INS_JZ:
+      case INS_JNZ:     to = opr; pop = 1; out = -1; break;
+      case INS_JLT:
+      case INS_JGE:
+      case INS_JEQ:
+      case INS_JNE:
+      case INS_JGT:
+      case INS_JLE:     to = opr; pop = 2; out = -2; break;
+      case INS_SWITCH:
+        if (opr < 0 || i + opr + 1 >= vDecLen) {
+          return vVerifyFail("malformed switch table", i);
+        }
+        table = opr + 1;
+        pop   = 1;
+        out   = -1;
+        falls = false;
+        break;
+      case INS_CALL:
+        if (vDecArgs[opr] < 0 || f == 0) {
+          // the callee never returns here
+          falls = false;
+        }
+        pop = (vDecArgs[opr] > 0) ? vDecArgs[opr] : 0;
+        out = 1 - pop;
+        if (f == 0 && d - pop < globals) {
+          globals = d - pop;
+        }
+        break;
+      case INS_TAILCALL:
+        // the callee must pop the arguments the caller was called with
+        if (f == 0) {
+          return vVerifyFail("tail call outside of a function", i);
+        }
+        if (vDecArgs[TAIL_TO(opr)] >= 0 &&
+            vDecArgs[TAIL_TO(opr)] != TAIL_ARGS(opr)) {
+          return vVerifyFail("tail call argument count differs", i);
+        }
+        pop   = TAIL_ARGS(opr);
+        falls = false;
+        break;
+      case INS_SCALL:
+        // the argument count must be the constant pushed just before
+        if (i == 0 || vDecIns[i - 1] != INS_CONST || target[i]) {
+          return vVerifyFail("system call argument count not constant", i);
+        }
+        pop = vScallPops(opr, vDec[i - 1].opr);
+        if (pop < 0) {
+          return vVerifyFail("unknown system call", i);
+        }
+        pop += 1;
+        out  = 1 - pop;
+        break;
+      case INS_RETURN:
+        pop   = 1;
+        falls = false;
+        break;
+      case DEC_BADPC:
+        return vVerifyFail("execution runs off the end of the code", i);
+      default:
+        return vVerifyFail("unknown instruction", i);
+      }
+
+      if (d - pop < 0 || (f == 0 && d - pop < vStackBase)) {
+        return vVerifyFail("stack underflow", i);
+      }
+      if (!vVerifySlot(i, f, d - pop, globals)) {
+        return false;
+      }
+      if (d + out > maxDepth) {
+        maxDepth = d + out;
+      }
+      if (maxDepth > NMEMORY) {
+        return vVerifyFail("stack overflow", i);
+      }
+      if (falls && !vVerifyEdge(i, i + 1, d + out)) {
+        return false;
+      }
+      if (to >= 0 && !vVerifyEdge(i, to, d + out)) {
+        return false;
+      }
+      // the loops go straight to the target of the table entry taken
+      for (int k=1; k<=table; ++k) {
+        if (vDecIns[i + k] != INS_JMP) {
+          return vVerifyFail("malformed switch table", i);
+        }
+        if (!vVerifyEdge(i, i + k, d + out)) {
+          return false;
+        }
+      }
+    }
+    vDecLimit[f] = NMEMORY - FRAMESIZE - maxDepth;
+  }
+  return true;
+}
+
+// print the instruction at vPC with the two cells on top of the stack
+void vTraceIns() {
+  printf("%4d, %4d,  | ", vPeek(0), vPeek(1));
+  dasm(cCode + vPC, vPC);
+  printf("\n");
+}
+
+// true if instructions 'i' to 'i + n' may run as one superinstruction.  only
+// the last may transfer control and nothing may jump or return into the
+// middle.  'target' marks the jump and call targets
+bool vFusable(int i, int n, bool *target) {
+  if (i + n > vDecLen) {
+    return false;
+  }
+  for (int k=0; k<n; ++k) {
+    int ins = vDecIns[i + k];
+    if (!insSymbol(ins) || (k > 0 && target[i + k])) {
+      return false;
+    }
+    if (k < n - 1 && (ins == INS_JMP  || ins == INS_JZ     ||
+                      ins == INS_JNZ  || ins == INS_CALL   ||
+                      ins == INS_TAILCALL ||
+                      ins == INS_RETURN || ins == INS_SWITCH ||
+                      (ins >= INS_JLT && ins <= INS_JLE))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// mark the jump and call targets in the decoded stream
+void vTargets(bool *target) {
+  for (int i=0; i<vDecLen; ++i) {
+    switch (vDecIns[i]) {
+    case INS_JMP:
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE:
+    case INS_CALL:
+      target[vDec[i].opr] = true;
+      break;
+    case INS_TAILCALL:
+      target[TAIL_TO(vDec[i].opr)] = true;
+      break;
+    case INS_SWITCH:
+      for (int k=1; k<=vDec[i].opr + 1 && i + k < vDecLen; ++k) {
+        target[i + k] = true;
+      }
+    }
+  }
+}
+
+// mark where the superinstructions in vsuper.h can be used, the longest
+// entry listed first wins
+void vFuse() {
+  static bool target[NDECODED];
+  vTargets(target);
+  for (int i=0; i<vDecLen; ++i) {
+    for (int k=1; k<NSUPER; ++k) {
+      int n = (vSuperSeq[k][2] < 0) ? 2 : 3;
+      if (!vFusable(i, n, target)) {
+        continue;
+      }
+      if (vDecIns[i]     == vSuperSeq[k][0] &&
+          vDecIns[i + 1] == vSuperSeq[k][1] &&
+          (n == 2 || vDecIns[i + 2] == vSuperSeq[k][2])) {
+        vSuper[i] = k;
+        break;
+      }
+    }
+  }
+}
+
+// print the most executed fusable sequences of length 'n' to stderr in the
+// format of vsuper.h
+void vProfileSeqs(int n, bool *target) {
+  static int       seq  [NDECODED][3];
+  static long long count[NDECODED];
+  int seqs = 0;
+
+  for (int i=0; i<vDecLen; ++i) {
+    if (!vProfile[i] || !vFusable(i, n, target)) {
+      continue;
+    }
+    int k = 0;
+    for (; k<seqs; ++k) {
+      if (!memcmp(seq[k], &vDecIns[i], n * sizeof(int))) {
+        break;
+      }
+    }
+    if (k == seqs) {
+      memcpy(seq[seqs], &vDecIns[i], n * sizeof(int));
+      count[seqs++] = 0;
+    }
+    count[k] += vProfile[i];
+  }
+
+  for (int shown=0; shown<NPROFILESEQS; ++shown) {
+    int best = -1;
+    for (int k=0; k<seqs; ++k) {
+      if (count[k] && (best < 0 || count[k] > count[best])) {
+        best = k;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    fprintf(stderr, "SUPER%u(", n);
+    for (int j=0; j<n; ++j) {
+      fprintf(stderr, "%s%s", j ? ", " : "", insSymbol(seq[best][j]));
+    }
+    fprintf(stderr, ")  // %lld\n", count[best]);
+    count[best] = 0;
+  }
+}
+
+// print how often each instruction was executed to stderr
+void vProfileDump() {
+  long long count[256] = { 0 };
+  long long total = 0;
+  for (int i=0; i<vDecLen; ++i) {
+    count[vDecIns[i]] += vProfile[i];
+    total += vProfile[i];
+  }
+  fprintf(stderr, "exec: profile, %lld instructions\n", total);
+  for (;;) {
+    int best = 0;
+    for (int ins=1; ins<256; ++ins) {
+      if (count[ins] > count[best]) {
+        best = ins;
+      }
+    }
+    if (!count[best]) {
+      break;
+    }
+    fprintf(stderr, "%12lld  %5.1f%%  %s\n", count[best],
+            100.0 * count[best] / total, insName(best));
+    count[best] = 0;
+  }
+
+  // candidates for vsuper.h
+  static bool target[NDECODED];
+  vTargets(target);
+  vProfileSeqs(3, target);
+  vProfileSeqs(2, target);
+}
+
+// direct threaded interpreter
+#define LOOP_NAME  vRunThreaded
+#define LOOP_TOS   0
+#define LOOP_CHECK 1
+#include "vloop.h"
+
+// direct threaded interpreter with top of stack caching
+#define LOOP_NAME  vRunCached
+#define LOOP_TOS   1
+#define LOOP_CHECK 1
+#include "vloop.h"
+
+// as above without stack checks for verified programs
+#define LOOP_NAME  vRunVerified
+#define LOOP_TOS   1
+#define LOOP_CHECK 0
+#include "vloop.h"
+
+// checked interpreter printing each instruction as it goes
+#define LOOP_NAME  vRunTracing
+#define LOOP_TOS   1
+#define LOOP_CHECK 1
+#define LOOP_TRACE 1
+#include "vloop.h"
+
+// checked interpreter counting each instruction executed
+#define LOOP_NAME    vRunProfiling
+#define LOOP_TOS     1
+#define LOOP_CHECK   1
+#define LOOP_PROFILE 1
+#include "vloop.h"
+
+// as above handing hot loops back to vRunTraced
+#define LOOP_NAME  vRunHot
+#define LOOP_TOS   1
+#define LOOP_CHECK 0
+#define LOOP_HOT   1
+#include "vloop.h"
+
+// step through one trip around the loop at 'head' noting each decoded
+// instruction executed, and for jumps if they were taken.  gives up on
+// calls, returns, switches, inner loops and long bodies.  returns the trace
+// length or 0 if no trace was recorded, either way vPC is left somewhere
+// valid.
+int vRecord(int head, int *trace, char *taken) {
+
+  int len = 0;
+  for (;;) {
+    if (cCode[vPC] == INS_LINE) {
+      vStep();
+      continue;
+    }
+    int i = vDecAt[vPC];
+    if (i == head && len > 0) {
+      return len;
+    }
+    if (len == NTRACE || vDecIns[i] == INS_CALL || vDecIns[i] == INS_RETURN ||
+        vDecIns[i] == INS_TAILCALL || vDecIns[i] == INS_SWITCH) {
+      return 0;
+    }
+    vStep();
+    int to = vDecAt[vPC];
+    trace[len]   = i;
+    taken[len++] = (to != i + 1);
+    if (to <= i && to != head) {
+      return 0;
+    }
+  }
+}
+
+// verified interpreter which compiles hot loops to native traces
+void vRunTraced() {
+
+  static int  trace[NTRACE];
+  static char taken[NTRACE];
+
+  for (;;) {
+    vRunHot();
+
+    // vPC is at a hot loop header
+    int head = vDecAt[vPC];
+    if (!vTrace[head]) {
+      int len = vRecord(head, trace, taken);
+      if (len) {
+        vTrace[head] = jitTrace(trace, taken, len);
+      }
+      if (!vTrace[head]) {
+        vHot[head] = INT_MIN;
+        continue;
+      }
+    }
+    vHot[head] = HOT_LOOP - 1;
+    jitRunTrace(vTrace[head]);
+  }
+}
+
+// as above handing hot loops and functions back to vRunTiered
+#define LOOP_NAME  vRunCounted
+#define LOOP_TOS   1
+#define LOOP_CHECK 0
+#define LOOP_HOT   1
+#define LOOP_CALLS 1
+#include "vloop.h"
+
+// check native code left us with the frame the verifier expects, as it
+// may have come here through a return address the program overwrote
+void vCheckFrame() {
+  if ((unsigned)vPC >= (unsigned)vCodeEnd || vDecAt[vPC] < 0) {
+    fatal("error: invalid vPC 0x%08x", vPC);
+  }
+  int i = vDecAt[vPC];
+  if (vDecDepth[i] != vStackPtr - vFP ||
+      vFP - FRAMESIZE > vDecLimit[vDecFunc[i]]) {
+    fatal("error: corrupt stack frame");
+  }
+}
+
+// verified interpreter which hands hot functions to a background compiler.
+// frames are laid out the same in native code, so it can be entered at a
+// function entry or at a loop header mid way through a call alike
+void vRunTiered() {
+
+  for (;;) {
+    vRunCounted();
+
+    // vPC is at a hot loop header or function entry
+    int i = vDecAt[vPC];
+    int f = vDecFunc[i];
+    vHot[i] = 0;
+    if (!jitReady(f)) {
+      jitQueue(f);
+      continue;
+    }
+    jitRunAt(i);
+    vCheckFrame();
+
+    // calls from native code to the interpreter count too
+    i = vDecAt[vPC];
+    if (vDecFunc[i] == i && ++vHot[i] >= HOT_CALL) {
+      vHot[i] = 0;
+      jitQueue(i);
+    }
+  }
+}
+
+int main(int argc, char **args) {
+
+  // usage: exec [-v] [-p] [-e engine] [file] [trace]
+  //        exec -b file input...
+  char *path    = NULL;
+  char **inputs = NULL;
+  int   batch   = false;
+  char *engine  = "verified";
+  int   trace   = false;
+  int   profile = false;
+  int   verbose = false;
+
+  for (int i=1; i<argc; ++i) {
+    if (strMatch(args[i], "-e") && i + 1 < argc) {
+      engine = args[++i];
+    }
+    else if (strMatch(args[i], "-v")) {
+      verbose = true;
+    }
+    else if (strMatch(args[i], "-p")) {
+      profile = true;
+    }
+    else if (strMatch(args[i], "-b")) {
+      batch = true;
+    }
+    else if (!path) {
+      path = args[i];
+    }
+    else if (batch) {
+      inputs = args + i;
+      break;
+    }
+    else {
+      trace = true;
+    }
+  }
+
+  FILE *fd = stdin;
+  if (path) {
+    fd = fopen(path, "r");
+  }
+  if (!fd) {
+    fatal("error: unable to open input file");
+  }
+
+  cCodeLen = fread(cCode, 4, NCODELEN, fd);
+  if (ferror(stdin)) {
+    fatal("error: fread error");
+  }
+
+  // start the stack after the code
+  vStackBase = cCodeLen;
+  vStackPtr  = cCodeLen;
+
+  // the reference interpreter, tracing gets a loop of its own
+  if (strMatch(engine, "switch")) {
+    while (trace) {
+      vTraceIns();
+      vStep();
+    }
+    for (;;) {
+      vStep();
+    }
+  }
+
+  // the threaded engines only return via exit
+  vDecode();
+  vFuse();
+  if (batch) {
+    if (!vVerify()) {
+      fatal("error: %u: batch mode needs a verified program, %s",
+            vVerifyPc, vVerifyErr);
+    }
+    if (inputs) {
+      bRun(inputs, args + argc - inputs);
+    }
+    return 0;
+  }
+  if (trace) {
+    vRunTracing();
+  }
+  else if (profile) {
+    atexit(vProfileDump);
+    vRunProfiling();
+  }
+  else if (strMatch(engine, "threaded")) {
+    vRunThreaded();
+  }
+  else if (strMatch(engine, "cached")) {
+    vRunCached();
+  }
+  else if (strMatch(engine, "verified")) {
+    if (vVerify()) {
+      vRunVerified();
+    }
+    if (verbose) {
+      fprintf(stderr, "exec: %u: verification failed, %s\n",
+              vVerifyPc, vVerifyErr);
+    }
+    vRunCached();
+  }
+  else if (strMatch(engine, "trace")) {
+    if (vVerify()) {
+      vRunTraced();
+    }
+    if (verbose) {
+      fprintf(stderr, "exec: %u: verification failed, %s\n",
+              vVerifyPc, vVerifyErr);
+    }
+    vRunCached();
+  }
+  else if (strMatch(engine, "tiered")) {
+    if (vVerify() && jitStart()) {
+      vRunTiered();
+    }
+    if (verbose) {
+      fprintf(stderr, "exec: %u: not compiled, %s\n",
+              vVerifyPc, vVerifyErr ? vVerifyErr : "out of memory");
+    }
+    vRunCached();
+  }
+  else if (strMatch(engine, "jit")) {
+    if (vVerify() && jitCompile()) {
+      jitRun();
+    }
+    if (verbose) {
+      fprintf(stderr, "exec: %u: not compiled, %s\n",
+              vVerifyPc, vVerifyErr ? vVerifyErr : "out of memory");
+    }
+    vRunCached();
+  }
+  else {
+    fatal("error: unknown engine '%s'", engine);
+  }
+
+  return 0;
+}
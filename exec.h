@@ -0,0 +1,60 @@
+#pragma once
+
+#include "defs.h"
+
+#define NMEMORY 1024*1024
+
+#define FRAMESIZE 2         // old FP, PC
+
+#define NDECODED  (NCODELEN * 2 + 1)
+
+#define HOT_LOOP  64        // backward jumps before a loop gets hot
+#define HOT_CALL  32        // calls before a function gets hot
+#define NTRACE    256       // longest trace recorded
+#define NPROFILESEQS 16     // sequences of each length a profile shows
+
+// pseudo instructions produced by the decoder
+#define DEC_BADPC   254     // jump to an invalid code position
+#define DEC_BADINS  255     // unknown instruction
+
+// a decoded instruction
+typedef struct {
+  void *op;                 // handler, filled in by the interpreter loop
+  int   opr;                // operand with addresses and targets resolved
+  int   pc;                 // code position it was decoded from
+} vdec_t;
+
+extern int   *cCode;
+extern int    cCodeLen;
+
+extern int   *vStack;
+extern int    vStackBase;
+extern int    vStackPtr;
+extern int    vPC;
+extern int    vFP;
+extern int    vST;
+
+extern vdec_t vDec[];
+extern int    vDecIns[];
+extern int    vDecLen;
+extern int    vDecAt[];
+extern int    vCodeEnd;
+
+extern int    vDecDepth[];
+extern int    vDecFunc[];
+extern int    vDecLimit[];
+
+void  vInsScall (int opr);
+int   vScallPops(int opr, int nargs);
+void  vTargets  (bool *target);
+
+void  bRun      (char **inputs, int count);
+
+bool  jitCompile ();
+void  jitRun     ();
+void *jitTrace   (int *trace, char *taken, int len);
+void  jitRunTrace(void *trace);
+bool  jitStart   ();
+void  jitQueue   (int f);
+bool  jitReady   (int f);
+void  jitRunAt   (int i);
@@ -0,0 +1,1004 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "exec.h"
+
+// baseline x86-64 template JIT
+//
+// every reachable instruction of a verified program is translated into a
+// fixed sequence of machine code.  the VM state stays exactly where the
+// interpreter keeps it, the stack is vStack and frames have the same layout,
+// only the registers move into machine registers:
+//
+//   rbx   &vStack[0]
+//   r12   stack pointer
+//   r13   frame pointer
+//   r14d  cached top of stack, as in vloop.h cells [0, sp-1) are in memory
+//   r15   jitTab, native return address for each code position
+//
+// control flow inside the code is direct jumps, returns go through jitTab
+// using the code position saved on the stack.  system calls and errors call
+// back into the C helpers.  the native stack is kept 16 byte aligned the
+// whole time so those calls need no fixup.
+//
+// functions can also be compiled one at a time by a background thread, see
+// jitStart, and the same templates also compile traces, straight line
+// copies of a hot loop body recorded by the interpreter, see jitTrace.
+
+#define NJITCODE  (1024 * 1024)
+
+#define RAX   0
+#define RCX   1
+#define RDX   2
+#define RBX   3
+#define RSP   4
+#define RBP   5
+#define RSI   6
+#define RDI   7
+#define R12   12
+#define R13   13
+#define R14   14
+#define R15   15
+#define NOREG -1
+
+// condition codes
+#define CC_B    0x2
+#define CC_AE   0x3
+#define CC_E    0x4
+#define CC_NE   0x5
+#define CC_L    0xC
+#define CC_GE   0xD
+#define CC_LE   0xE
+#define CC_G    0xF
+
+// runtime errors raised from native code
+#define ERR_DIV      0
+#define ERR_DEREF    1
+#define ERR_LVALUE   2
+#define ERR_OVERFLOW 3
+#define ERR_FRAME    4
+#define ERR_PC       5
+#define NERRS        6
+
+unsigned char *jCode;                // code buffer
+int            jLen;                 // bytes of code emitted
+
+int            jAt   [NDECODED];     // native offset of each instruction
+int            jFixAt[NDECODED];     // offsets of rel32 jump operands
+int            jFixTo[NDECODED];     // instruction each one jumps to
+int            jFixes;               // number of jumps to patch
+
+int            jErr[NERRS];          // offsets of the error stubs
+int            jExit;                // offset of the exit stub
+int            jLeave;               // offset of the return to the interpreter
+int            jRet  [NDECODED];     // offset returns to each instruction use
+
+int            jOnly;                // function being compiled, -1 for all
+
+void          *jitTab[NCODELEN + 1]; // native return address by code position
+void          *jitFn [NDECODED];     // native entry of each function
+bool           jReady [NDECODED];    // function has been compiled
+bool           jQueued[NDECODED];    // function was queued for compiling
+
+int             jQueue[NDECODED];    // functions waiting to be compiled
+unsigned        jQueueHead;
+unsigned        jQueueTail;
+pthread_mutex_t jQueueLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  jQueueWake = PTHREAD_COND_INITIALIZER;
+void         (*jitEnter)(void *);    // entry trampoline
+
+//----------------------------------------------------------------------------
+// HELPERS
+//----------------------------------------------------------------------------
+
+void jitError(int err, int value) {
+  switch (err) {
+  case ERR_DIV:      fatal("error: division by zero");
+  case ERR_DEREF:    fatal("error: invalid dereference");
+  case ERR_LVALUE:   fatal("error: invalid lvalue address");
+  case ERR_OVERFLOW: fatal("error: stack overflow");
+  case ERR_FRAME:    fatal("error: corrupt stack frame");
+  case ERR_PC:       fatal("error: invalid vPC 0x%08x", value);
+  }
+}
+
+//----------------------------------------------------------------------------
+// ENCODER
+//----------------------------------------------------------------------------
+
+void jByte(int b) {
+  if (jLen >= NJITCODE) {
+    fatal("error: jit code buffer full");
+  }
+  jCode[jLen++] = b;
+}
+
+void jInt(int v) {
+  jByte(v);
+  jByte(v >> 8);
+  jByte(v >> 16);
+  jByte(v >> 24);
+}
+
+void jPtr(void *p) {
+  long long v = (long long)p;
+  jInt((int)v);
+  jInt((int)(v >> 32));
+}
+
+// emit an optional rex prefix and a one or two byte opcode
+void jOp(int w, int op, int reg, int index, int base) {
+  int rex = 0x40 | (w << 3) | ((reg   >> 3) & 1) << 2
+                            | ((index >> 3) & 1) << 1
+                            | ((base  >> 3) & 1);
+  if (rex != 0x40) {
+    jByte(rex);
+  }
+  if (op > 0xff) {
+    jByte(op >> 8);
+  }
+  jByte(op);
+}
+
+// op reg, rm  (register to register)
+void jRR(int w, int op, int reg, int rm) {
+  jOp(w, op, reg, 0, rm);
+  jByte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// op reg, [base + index * scale + disp]
+void jMem(int w, int op, int reg, int base, int index, int scale, int disp) {
+  jOp(w, op, reg, (index == NOREG) ? 0 : index, base);
+  int mod = 2;
+  if (disp == 0 && (base & 7) != RBP) {
+    mod = 0;
+  }
+  else if (disp >= -128 && disp <= 127) {
+    mod = 1;
+  }
+  if (index != NOREG) {
+    int ss = (scale == 8) ? 3 : (scale == 4) ? 2 : (scale == 2) ? 1 : 0;
+    jByte(mod << 6 | (reg & 7) << 3 | 4);
+    jByte(ss << 6 | (index & 7) << 3 | (base & 7));
+  }
+  else {
+    jByte(mod << 6 | (reg & 7) << 3 | (base & 7));
+    if ((base & 7) == RSP) {
+      jByte(0x24);
+    }
+  }
+  if (mod == 1) {
+    jByte(disp);
+  }
+  if (mod == 2) {
+    jInt(disp);
+  }
+}
+
+// op reg, stack cell relative to the stack pointer
+void jCell(int op, int reg, int cell) {
+  jMem(0, op, reg, RBX, R12, 4, cell * 4);
+}
+
+// op reg, variable cell relative to the frame pointer
+void jFrame(int op, int reg, int cell) {
+  jMem(0, op, reg, RBX, R13, 4, cell * 4);
+}
+
+// mov reg, imm32
+void jMovImm(int reg, int imm) {
+  jOp(0, 0xB8 + (reg & 7), 0, 0, reg);
+  jInt(imm);
+}
+
+// mov reg, imm64
+void jMovPtr(int reg, void *p) {
+  jOp(1, 0xB8 + (reg & 7), 0, 0, reg);
+  jPtr(p);
+}
+
+// op reg, imm32 using the 0x81 group, 'ext' selects the operation
+void jGroupImm(int w, int ext, int reg, int imm) {
+  if (imm >= -128 && imm <= 127) {
+    jRR(w, 0x83, ext, reg);
+    jByte(imm);
+  }
+  else {
+    jRR(w, 0x81, ext, reg);
+    jInt(imm);
+  }
+}
+
+void jCmpImm(int reg, int imm) { jGroupImm(0, 7, reg, imm); }
+void jAddSp (int imm)          { jGroupImm(1, 0, R12, imm); }
+void jIncSp ()                 { jRR(1, 0xFF, 0, R12); }
+void jDecSp ()                 { jRR(1, 0xFF, 1, R12); }
+
+// call a C function through rax
+void jCall(void *fn) {
+  jMovPtr(RAX, fn);
+  jByte(0xFF);
+  jByte(0xD0);
+}
+
+// jump to a known native offset
+void jJmpTo(int at) {
+  jByte(0xE9);
+  jInt(at - (jLen + 4));
+}
+
+void jJccTo(int cc, int at) {
+  jByte(0x0F);
+  jByte(0x80 | cc);
+  jInt(at - (jLen + 4));
+}
+
+// jump to a decoded instruction, patched once everything is emitted
+void jJmpIns(int i) {
+  jByte(0xE9);
+  jFixAt[jFixes]   = jLen;
+  jFixTo[jFixes++] = i;
+  jInt(0);
+}
+
+void jJccIns(int cc, int i) {
+  jByte(0x0F);
+  jByte(0x80 | cc);
+  jFixAt[jFixes]   = jLen;
+  jFixTo[jFixes++] = i;
+  jInt(0);
+}
+
+// r14d = cc ? 1 : 0
+void jSetTos(int cc) {
+  jByte(0x0F);
+  jByte(0x90 | cc);
+  jByte(0xC0);                // setcc al
+  jRR(0, 0x0FB6, R14, RAX);   // movzx r14d, al
+}
+
+//----------------------------------------------------------------------------
+// TEMPLATES
+//----------------------------------------------------------------------------
+
+// write the cached top back to memory
+void jSpill() { jCell(0x89, R14, -1); }
+
+// reload the cached top from memory
+void jFill()  { jCell(0x8B, R14, -1); }
+
+// make room for a new top of stack, the caller sets r14d
+void jGrow() {
+  jSpill();
+  jIncSp();
+}
+
+// pop the rhs leaving the lhs in eax and the rhs in r14d
+void jBinop() {
+  jDecSp();
+  jCell(0x8B, RAX, -1);
+}
+
+// condition code a fused compare and jump branches on
+int jCond(int ins) {
+  switch (ins) {
+  case INS_JLT: return CC_L;
+  case INS_JGE: return CC_GE;
+  case INS_JEQ: return CC_E;
+  case INS_JNE: return CC_NE;
+  case INS_JGT: return CC_G;
+  default:      return CC_LE;
+  }
+}
+
+// pop both operands of a fused compare and jump and compare them
+void jCompareJcc() {
+  jBinop();
+  jRR(0, 0x8B, RCX, R14);     // mov ecx, r14d
+  jDecSp();
+  jFill();
+  jRR(0, 0x3B, RAX, RCX);     // cmp eax, ecx
+}
+
+void jCompare(int cc) {
+  jBinop();
+  jRR(0, 0x3B, RAX, R14);     // cmp eax, r14d
+  jSetTos(cc);
+}
+
+// emit the template for decoded instruction 'i'
+void jIns(int i) {
+  int opr = vDec[i].opr;
+  int k;
+
+  switch (vDecIns[i]) {
+  case INS_DEREF:
+    jMem(0, 0x8D, RAX, R12, NOREG, 0, -1);  // lea eax, [r12 - 1]
+    jRR(0, 0x3B, R14, RAX);                 // cmp r14d, eax
+    jJccTo(CC_AE, jErr[ERR_DEREF]);
+    jMem(0, 0x8B, R14, RBX, R14, 4, 0);     // mov r14d, [rbx + r14*4]
+    break;
+
+  case INS_DROP:
+    jDecSp();
+    jFill();
+    break;
+
+  case TOK_LOGNOT:
+    jRR(0, 0x85, R14, R14);                 // test r14d, r14d
+    jSetTos(CC_E);
+    break;
+
+  case INS_NEG:
+    jRR(0, 0xF7, 3, R14);                   // neg r14d
+    break;
+
+  case TOK_ASSIGN:
+    jBinop();
+    jMem(0, 0x8D, RCX, R12, NOREG, 0, -1);  // lea ecx, [r12 - 1]
+    jRR(0, 0x3B, RAX, RCX);                 // cmp eax, ecx
+    jJccTo(CC_AE, jErr[ERR_LVALUE]);
+    jMem(0, 0x89, R14, RBX, RAX, 4, 0);     // mov [rbx + rax*4], r14d
+    break;
+
+  case INS_INDEX:
+    jBinop();
+    jRR(0, 0x03, R14, RAX);                 // add r14d, eax
+    jMem(0, 0x8D, RAX, R12, NOREG, 0, -1);  // lea eax, [r12 - 1]
+    jRR(0, 0x3B, R14, RAX);                 // cmp r14d, eax
+    jJccTo(CC_AE, jErr[ERR_DEREF]);
+    jMem(0, 0x8B, R14, RBX, R14, 4, 0);     // mov r14d, [rbx + r14*4]
+    break;
+
+  case INS_STOREX:
+    jCell(0x8B, RAX, -3);                   // mov eax, [base]
+    jCell(0x03, RAX, -2);                   // add eax, [index]
+    jAddSp(-2);
+    jMem(0, 0x8D, RCX, R12, NOREG, 0, -1);  // lea ecx, [r12 - 1]
+    jRR(0, 0x3B, RAX, RCX);                 // cmp eax, ecx
+    jJccTo(CC_AE, jErr[ERR_LVALUE]);
+    jMem(0, 0x89, R14, RBX, RAX, 4, 0);     // mov [rbx + rax*4], r14d
+    break;
+
+  case INS_SELECT:
+    jCell(0x8B, RCX, -2);                   // mov ecx, [first]
+    jCell(0x8B, RAX, -3);                   // mov eax, [condition]
+    jAddSp(-2);
+    jRR(0, 0x85, RAX, RAX);                 // test eax, eax
+    jRR(0, 0x0F45, R14, RCX);               // cmovne r14d, ecx
+    break;
+
+  case INS_ADDASSIGN:
+    jBinop();
+    jMem(0, 0x8D, RCX, R12, NOREG, 0, -1);  // lea ecx, [r12 - 1]
+    jRR(0, 0x3B, RAX, RCX);                 // cmp eax, ecx
+    jJccTo(CC_AE, jErr[ERR_LVALUE]);
+    jMem(0, 0x03, R14, RBX, RAX, 4, 0);     // add r14d, [rbx + rax*4]
+    jMem(0, 0x89, R14, RBX, RAX, 4, 0);     // mov [rbx + rax*4], r14d
+    break;
+
+  case TOK_ADD:
+    jBinop();
+    jRR(0, 0x03, R14, RAX);                 // add r14d, eax
+    break;
+
+  case TOK_SUB:
+    jBinop();
+    jRR(0, 0x2B, RAX, R14);                 // sub eax, r14d
+    jRR(0, 0x8B, R14, RAX);                 // mov r14d, eax
+    break;
+
+  case TOK_MUL:
+    jBinop();
+    jRR(0, 0x0FAF, R14, RAX);               // imul r14d, eax
+    break;
+
+  case TOK_DIV:
+  case TOK_MOD:
+    jRR(0, 0x85, R14, R14);                 // test r14d, r14d
+    jJccTo(CC_E, jErr[ERR_DIV]);
+    jBinop();
+    jByte(0x99);                            // cdq
+    jRR(0, 0xF7, 7, R14);                   // idiv r14d
+    jRR(0, 0x8B, R14, vDecIns[i] == TOK_DIV ? RAX : RDX);
+    break;
+
+  case TOK_BITAND:
+    jBinop();
+    jRR(0, 0x23, R14, RAX);                 // and r14d, eax
+    break;
+
+  case TOK_BITOR:
+    jBinop();
+    jRR(0, 0x0B, R14, RAX);                 // or r14d, eax
+    break;
+
+  case TOK_BITXOR:
+    jBinop();
+    jRR(0, 0x33, R14, RAX);                 // xor r14d, eax
+    break;
+
+  case TOK_SHL:
+  case TOK_SHR:
+    jBinop();
+    jRR(0, 0x8B, RCX, R14);                 // mov ecx, r14d
+    jRR(0, 0x8B, R14, RAX);                 // mov r14d, eax
+    jRR(0, 0xD3, vDecIns[i] == TOK_SHL ? 4 : 7, R14);  // shl/sar r14d, cl
+    break;
+
+  case TOK_LOGOR:
+    jBinop();
+    jRR(0, 0x0B, RAX, R14);                 // or eax, r14d
+    jSetTos(CC_NE);
+    break;
+
+  case TOK_LOGAND:
+    jBinop();
+    jRR(0, 0x85, RAX, RAX);                 // test eax, eax
+    jByte(0x0F); jByte(0x95); jByte(0xC1);  // setne cl
+    jRR(0, 0x85, R14, R14);                 // test r14d, r14d
+    jByte(0x0F); jByte(0x95); jByte(0xC0);  // setne al
+    jByte(0x20); jByte(0xC8);               // and al, cl
+    jRR(0, 0x0FB6, R14, RAX);               // movzx r14d, al
+    break;
+
+  case TOK_LT:     jCompare(CC_L);  break;
+  case TOK_GT:     jCompare(CC_G);  break;
+  case TOK_LTEQU:  jCompare(CC_LE); break;
+  case TOK_GTEQU:  jCompare(CC_GE); break;
+  case TOK_EQU:    jCompare(CC_E);  break;
+  case TOK_NEQU:   jCompare(CC_NE); break;
+
+  case INS_DUP:
+    jGrow();
+    break;
+
+  case INS_SWAP:
+    jCell(0x8B, RAX, -2);                   // mov eax, [cell - 2]
+    jCell(0x89, R14, -2);                   // mov [cell - 2], r14d
+    jRR(0, 0x8B, R14, RAX);                 // mov r14d, eax
+    break;
+
+  case INS_STRTAB:
+    jMovPtr(RAX, &vST);
+    jMem(0, 0xC7, 0, RAX, NOREG, 0, 0);     // mov dword [rax], imm32
+    jInt(opr);
+    break;
+
+  case INS_STR:
+    jGrow();
+    jMovPtr(RAX, &vST);
+    jMem(0, 0x8B, R14, RAX, NOREG, 0, 0);   // mov r14d, [rax]
+    jGroupImm(0, 0, R14, opr);              // add r14d, opr
+    break;
+
+  case INS_CONST:
+    jGrow();
+    jMovImm(R14, opr);
+    break;
+
+  case INS_GETAL:
+    jGrow();
+    jMem(0, 0x8D, R14, R13, NOREG, 0, opr);                // lea r14d, [r13 + opr]
+    break;
+
+  case INS_GETAA:
+    jGrow();
+    jMem(0, 0x8D, R14, R13, NOREG, 0, -opr - FRAMESIZE);   // lea r14d, [r13 - opr - 2]
+    break;
+
+  // variable accesses were proven in range by the verifier
+  case INS_LOADL:
+    jGrow();
+    jFrame(0x8B, R14, opr);                                // mov r14d, [local]
+    break;
+
+  case INS_STOREL:
+    jFrame(0x89, R14, opr);                                // mov [local], r14d
+    break;
+
+  case INS_LOADA:
+    jGrow();
+    jFrame(0x8B, R14, -opr - FRAMESIZE);                   // mov r14d, [argument]
+    break;
+
+  case INS_STOREA:
+    jFrame(0x89, R14, -opr - FRAMESIZE);                   // mov [argument], r14d
+    break;
+
+  case INS_LOADG:
+    jGrow();
+    jMem(0, 0x8B, R14, RBX, NOREG, 0, opr * 4);            // mov r14d, [global]
+    break;
+
+  case INS_STOREG:
+    jMem(0, 0x89, R14, RBX, NOREG, 0, opr * 4);            // mov [global], r14d
+    break;
+
+  case INS_INCL:
+  case INS_INCA:
+    k = INC_SLOT(opr);
+    k = (vDecIns[i] == INS_INCL) ? k : -k - FRAMESIZE;
+    jGrow();
+    jFrame(0x8B, R14, k);                                  // mov r14d, [var]
+    jGroupImm(0, 0, R14, INC_BY(opr));                     // add r14d, opr
+    jFrame(0x89, R14, k);                                  // mov [var], r14d
+    break;
+
+  case INS_INCG:
+    k = (vStackBase + INC_SLOT(opr)) * 4;
+    jGrow();
+    jMem(0, 0x8B, R14, RBX, NOREG, 0, k);                  // mov r14d, [global]
+    jGroupImm(0, 0, R14, INC_BY(opr));                     // add r14d, opr
+    jMem(0, 0x89, R14, RBX, NOREG, 0, k);                  // mov [global], r14d
+    break;
+
+  case INS_ALLOC:
+  case INS_ENTER:
+    if (opr <= 0) {
+      break;
+    }
+    jSpill();
+    if (opr <= 16) {
+      for (int k=0; k<opr; ++k) {
+        jMem(0, 0xC7, 0, RBX, R12, 4, k * 4);  // mov dword [cell + k], 0
+        jInt(0);
+      }
+    }
+    else {
+      jMem(1, 0x8D, RDI, RBX, R12, 4, 0);      // lea rdi, [rbx + r12*4]
+      jMovImm(RCX, opr);
+      jRR(0, 0x31, RAX, RAX);                  // xor eax, eax
+      jByte(0xF3);
+      jByte(0xAB);                             // rep stosd
+    }
+    jAddSp(opr);
+    jRR(0, 0x31, R14, R14);                    // xor r14d, r14d
+    break;
+
+  case INS_JMP:
+    jJmpIns(opr);
+    break;
+
+  case INS_JZ:
+  case INS_JNZ:
+    jRR(0, 0x8B, RAX, R14);                 // mov eax, r14d
+    jDecSp();
+    jFill();
+    jRR(0, 0x85, RAX, RAX);                 // test eax, eax
+    jJccIns(vDecIns[i] == INS_JZ ? CC_E : CC_NE, opr);
+    break;
+
+  case INS_JLT:
+  case INS_JGE:
+  case INS_JEQ:
+  case INS_JNE:
+  case INS_JGT:
+  case INS_JLE:
+    jCompareJcc();
+    jJccIns(jCond(vDecIns[i]), opr);
+    break;
+
+  case INS_SWITCH:
+    // the table entries follow as 5 byte jumps, index into them
+    jRR(0, 0x8B, RAX, R14);                 // mov eax, r14d
+    jDecSp();
+    jFill();
+    jMovImm(RCX, opr);
+    jRR(0, 0x3B, RAX, RCX);                 // cmp eax, ecx
+    jRR(0, 0x0F47, RAX, RCX);               // cmova eax, ecx
+    jMem(1, 0x8D, RAX, RAX, RAX, 4, 0);     // lea rax, [rax + rax*4]
+    jByte(0x48); jByte(0x8D); jByte(0x0D);
+    jInt(5);                                // lea rcx, [rip + 5]
+    jRR(1, 0x01, RAX, RCX);                 // add rcx, rax
+    jByte(0xFF); jByte(0xE1);               // jmp rcx
+    break;
+
+  case INS_CALL:
+    // one check covers everything the callee pushes
+    jCmpImm(R12, vDecLimit[opr]);
+    jJccTo(CC_G, jErr[ERR_OVERFLOW]);
+    jSpill();
+    jCell(0x89, R13, 0);                    // mov [cell], r13d
+    jAddSp(2);
+    jMovImm(R14, vDec[i].pc + 2);
+    jRR(1, 0x8B, R13, R12);                 // mov r13, r12
+    if (jOnly < 0 || jOnly == opr) {
+      jJmpIns(opr);
+    }
+    else {
+      // the callee may not be compiled yet
+      jMovPtr(RAX, &jitFn[opr]);
+      jMem(0, 0xFF, 4, RAX, NOREG, 0, 0);   // jmp [rax]
+    }
+    break;
+
+  case INS_TAILCALL: {
+    int args = TAIL_ARGS(opr);
+    int move = args - TAIL_DROP(opr);       // how far the frame moves
+    opr = TAIL_TO(opr);
+    jMem(0, 0x8D, RAX, R13, NOREG, 0, move - FRAMESIZE);
+    jCmpImm(RAX, vDecLimit[opr]);           // as a call from the base
+    jJccTo(CC_G, jErr[ERR_OVERFLOW]);
+    jSpill();
+    jFrame(0x8B, RCX, -2);                  // mov ecx, [old fp]
+    jFrame(0x8B, R14, -1);                  // mov r14d, [pc]
+    for (k=0; k<args; ++k) {
+      jCell(0x8B, RAX, k - args);
+      jFrame(0x89, RAX, k - args + move - FRAMESIZE);
+    }
+    jFrame(0x89, RCX, move - 2);
+    jFrame(0x89, R14, move - 1);
+    jMem(1, 0x8D, R13, R13, NOREG, 0, move);
+    jRR(1, 0x8B, R12, R13);                 // mov r12, r13
+    if (jOnly < 0 || jOnly == opr) {
+      jJmpIns(opr);
+    }
+    else {
+      jMovPtr(RAX, &jitFn[opr]);
+      jMem(0, 0xFF, 4, RAX, NOREG, 0, 0);   // jmp [rax]
+    }
+    break;
+  }
+
+  case INS_RETURN:
+    jMem(0, 0x8B, RAX, RBX, R13, 4, -4);    // pc
+    jMem(0, 0x8B, RCX, RBX, R13, 4, -8);    // old fp
+    jMem(1, 0x8D, R12, R13, NOREG, 0, -1 - opr);
+    jRR(0, 0x8B, R13, RCX);                 // mov r13d, ecx
+    jCmpImm(R13, vStackBase);
+    jJccTo(CC_LE, jExit);
+    jCmpImm(RAX, vCodeEnd);
+    jJccTo(CC_AE, jErr[ERR_PC]);
+    jMem(0, 0xFF, 4, R15, RAX, 8, 0);       // jmp [r15 + rax*8]
+    break;
+
+  case INS_SCALL:
+    jSpill();
+    jMovPtr(RAX, &vStackPtr);
+    jMem(0, 0x89, R12, RAX, NOREG, 0, 0);   // mov [rax], r12d
+    jMovImm(RDI, opr);
+    jCall(vInsScall);
+    jMovPtr(RAX, &vStackPtr);
+    jMem(0, 0x8B, R12, RAX, NOREG, 0, 0);   // mov r12d, [rax]
+    jFill();
+    break;
+
+  default:
+    fatal("error: jit cant translate instruction %u", vDecIns[i]);
+  }
+}
+
+// check a return landed with the frame this call site expects
+void jReturnSite(int i) {
+  jRR(0, 0x8B, RCX, R12);                   // mov ecx, r12d
+  jRR(0, 0x2B, RCX, R13);                   // sub ecx, r13d
+  jCmpImm(RCX, vDecDepth[i]);
+  jJccTo(CC_NE, jErr[ERR_FRAME]);
+  jCmpImm(R13, vDecLimit[vDecFunc[i]] + FRAMESIZE);
+  jJccTo(CC_G, jErr[ERR_FRAME]);
+}
+
+//----------------------------------------------------------------------------
+// DRIVER
+//----------------------------------------------------------------------------
+
+void jPrologue() {
+  static const int saved[] = { RBX, RBP, R12, R13, R14, R15 };
+  for (int k=0; k<6; ++k) {
+    jOp(0, 0x50 + (saved[k] & 7), 0, 0, saved[k]);  // push
+  }
+  jGroupImm(1, 5, RSP, 8);                // sub rsp, 8 to align the stack
+  jMovPtr(RBX, vStack);
+  jMovPtr(RAX, &vStackPtr);
+  jMem(0, 0x8B, R12, RAX, NOREG, 0, 0);   // mov r12d, [vStackPtr]
+  jMovPtr(RAX, &vFP);
+  jMem(0, 0x8B, R13, RAX, NOREG, 0, 0);   // mov r13d, [vFP]
+  jFill();
+  jMovPtr(R15, jitTab);
+  jByte(0xFF);
+  jByte(0xE7);                            // jmp rdi
+}
+
+// leave native code, saving the VM registers back to the globals
+void jEpilogue() {
+  static const int saved[] = { R15, R14, R13, R12, RBP, RBX };
+  jSpill();
+  jMovPtr(RAX, &vStackPtr);
+  jMem(0, 0x89, R12, RAX, NOREG, 0, 0);   // mov [vStackPtr], r12d
+  jMovPtr(RAX, &vFP);
+  jMem(0, 0x89, R13, RAX, NOREG, 0, 0);   // mov [vFP], r13d
+  jGroupImm(1, 0, RSP, 8);                // add rsp, 8
+  for (int k=0; k<6; ++k) {
+    jOp(0, 0x58 + (saved[k] & 7), 0, 0, saved[k]);  // pop
+  }
+  jByte(0xC3);                            // ret
+}
+
+// map the code buffer and emit the code shared by everything compiled
+bool jInit() {
+
+  if (jCode) {
+    return true;
+  }
+  jCode = mmap(NULL, NJITCODE, PROT_READ | PROT_WRITE | PROT_EXEC,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (jCode == MAP_FAILED) {
+    jCode = NULL;
+    return false;
+  }
+
+  jitEnter = (void (*)(void *))jCode;
+  jPrologue();
+
+  jLeave = jLen;
+  jEpilogue();
+
+  // stubs leaving native code for good
+  for (int e=0; e<NERRS; ++e) {
+    jErr[e] = jLen;
+    jMovImm(RDI, e);
+    jRR(0, 0x8B, RSI, RAX);               // mov esi, eax
+    jCall(jitError);
+  }
+  jExit = jLen;
+  jRR(0, 0x8B, RDI, R14);                 // mov edi, r14d
+  jCall(exit);
+  return true;
+}
+
+// translate the instructions of function 'f', or the whole program when
+// it is -1.  everything must have passed vVerify
+void jEmit(int f) {
+
+  jOnly  = f;
+  jFixes = 0;
+
+  for (int i=0; i<vDecLen; ++i) {
+    jRet[i] = -1;
+  }
+
+  for (int i=0; i<vDecLen; ++i) {
+    if (vDecDepth[i] < 0 || (f >= 0 && vDecFunc[i] != f)) {
+      continue;
+    }
+    // returns land here via jitTab
+    if (i > 0 && vDecIns[i - 1] == INS_CALL) {
+      jRet[i] = jLen;
+      jReturnSite(i);
+    }
+    jAt[i] = jLen;
+    jIns(i);
+  }
+
+  // a program can overwrite its return address, anywhere the frame checks
+  // out is still a legal place to land so give the rest a check of their own
+  for (int i=0; i<vDecLen; ++i) {
+    if (vDecDepth[i] < 0 || (f >= 0 && vDecFunc[i] != f)) {
+      continue;
+    }
+    if (jRet[i] < 0) {
+      jRet[i] = jLen;
+      jReturnSite(i);
+      jJmpTo(jAt[i]);
+    }
+  }
+
+  for (int k=0; k<jFixes; ++k) {
+    int at = jFixAt[k];
+    int to = jAt[jFixTo[k]];
+    int rel = to - (at + 4);
+    memcpy(jCode + at, &rel, 4);
+  }
+
+  // only now is it safe to send returns to the new code
+  for (int pc=0; pc<vCodeEnd; ++pc) {
+    int i = vDecAt[pc];
+    if (i >= 0 && jRet[i] >= 0) {
+      __atomic_store_n(&jitTab[pc], jCode + jRet[i], __ATOMIC_RELEASE);
+    }
+  }
+}
+
+// translate the whole program, which must have passed vVerify
+bool jitCompile() {
+
+  if (!jInit()) {
+    return false;
+  }
+
+  for (int pc=0; pc<vCodeEnd; ++pc) {
+    int i = vDecAt[pc];
+    jitTab[pc] = jCode + jErr[(i < 0) ? ERR_PC : ERR_FRAME];
+  }
+  jEmit(-1);
+  return true;
+}
+
+// run the translated program from vPC, only returns via exit
+void jitRun() {
+  jitEnter(jCode + jAt[vDecAt[vPC]]);
+}
+
+//----------------------------------------------------------------------------
+// BACKGROUND COMPILER
+//----------------------------------------------------------------------------
+
+// compile function 'f' unless there isn't room left for it
+void jFunc(int f) {
+
+  int n = 0;
+  for (int i=0; i<vDecLen; ++i) {
+    n += (vDecFunc[i] == f);
+  }
+  if (jLen > NJITCODE - n * 256) {
+    return;
+  }
+  jEmit(f);
+  __atomic_store_n(&jitFn[f], jCode + jAt[f], __ATOMIC_RELEASE);
+  __atomic_store_n(&jReady[f], true, __ATOMIC_RELEASE);
+}
+
+void *jWorker(void *arg) {
+  for (;;) {
+    pthread_mutex_lock(&jQueueLock);
+    while (jQueueHead == jQueueTail) {
+      pthread_cond_wait(&jQueueWake, &jQueueLock);
+    }
+    int f = jQueue[jQueueHead++ % NDECODED];
+    pthread_mutex_unlock(&jQueueLock);
+    jFunc(f);
+  }
+  return arg;
+}
+
+// set up for compiling functions one at a time as they get hot.  until a
+// function is ready calls to it and returns into it leave native code so
+// the interpreter can carry on from there.  returns false on failure.
+bool jitStart() {
+
+  if (!jInit()) {
+    return false;
+  }
+
+  // leave at the code position being returned to
+  int leaveRet = jLen;
+  jMovPtr(RCX, &vPC);
+  jMem(0, 0x89, RAX, RCX, NOREG, 0, 0);   // mov [vPC], eax
+  jJmpTo(jLeave);
+
+  for (int pc=0; pc<vCodeEnd; ++pc) {
+    int i = vDecAt[pc];
+    jitTab[pc] = jCode + ((i < 0) ? jErr[ERR_PC] :
+                          (vDecDepth[i] < 0) ? jErr[ERR_FRAME] : leaveRet);
+  }
+
+  // leave at the entry of a function called
+  for (int i=0; i<vDecLen; ++i) {
+    if (vDecFunc[i] == i && vDecDepth[i] >= 0) {
+      jitFn[i] = jCode + jLen;
+      jMovPtr(RAX, &vPC);
+      jMem(0, 0xC7, 0, RAX, NOREG, 0, 0); // mov dword [vPC], pc
+      jInt(vDec[i].pc);
+      jJmpTo(jLeave);
+    }
+  }
+
+  pthread_t thread;
+  return pthread_create(&thread, NULL, jWorker, NULL) == 0;
+}
+
+// ask the background thread to compile function 'f'
+void jitQueue(int f) {
+  if (jQueued[f]) {
+    return;
+  }
+  jQueued[f] = true;
+  pthread_mutex_lock(&jQueueLock);
+  jQueue[jQueueTail++ % NDECODED] = f;
+  pthread_cond_signal(&jQueueWake);
+  pthread_mutex_unlock(&jQueueLock);
+}
+
+// true once function 'f' can be run natively
+bool jitReady(int f) {
+  return __atomic_load_n(&jReady[f], __ATOMIC_ACQUIRE);
+}
+
+// run natively from decoded instruction 'i' of a ready function, returns
+// once execution reaches code which isn't compiled yet
+void jitRunAt(int i) {
+  jitEnter(jCode + jAt[i]);
+}
+
+//----------------------------------------------------------------------------
+// TRACES
+//----------------------------------------------------------------------------
+
+// compile a trace recorded by vRecord, 'trace' holds the decoded
+// instructions executed from a loop header until it came back around and
+// 'taken' which way each conditional jump went.  the native loop runs until
+// a guard sees a jump go the other way and then returns to the interpreter
+// at the code position the jump leads to.  returns NULL on failure.
+void *jitTrace(int *trace, char *taken, int len) {
+
+  int exitAt[NTRACE];                     // rel32 operands of the guards
+  int exitPc[NTRACE];                     // code position each guard exits to
+  int exits = 0;
+
+  if (!jInit() || jLen > NJITCODE - NTRACE * 64) {
+    return NULL;
+  }
+
+  int start = jLen;
+  for (int k=0; k<len; ++k) {
+    int i   = trace[k];
+    int opr = vDec[i].opr;
+
+    switch (vDecIns[i]) {
+    case INS_JMP:
+      // the trace just carries on with the target
+      break;
+
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE: {
+      int cc;
+      if (vDecIns[i] == INS_JZ || vDecIns[i] == INS_JNZ) {
+        jRR(0, 0x8B, RAX, R14);           // mov eax, r14d
+        jDecSp();
+        jFill();
+        jRR(0, 0x85, RAX, RAX);           // test eax, eax
+        cc = (vDecIns[i] == INS_JZ) ? CC_E : CC_NE;
+      }
+      else {
+        jCompareJcc();
+        cc = jCond(vDecIns[i]);
+      }
+      if (opr == i + 1) {
+        break;
+      }
+      jByte(0x0F);
+      jByte(0x80 | (taken[k] ? cc ^ 1 : cc));
+      exitAt[exits]   = jLen;
+      exitPc[exits++] = taken[k] ? vDec[i + 1].pc : vDec[opr].pc;
+      jInt(0);
+      break;
+    }
+
+    case INS_CALL:
+    case INS_TAILCALL:
+    case INS_RETURN:
+    case INS_SWITCH:
+      fatal("error: jit cant trace instruction %u", vDecIns[i]);
+
+    default:
+      jIns(i);
+    }
+  }
+  jJmpTo(start);
+
+  // side exits back to the interpreter
+  for (int e=0; e<exits; ++e) {
+    int rel = jLen - (exitAt[e] + 4);
+    memcpy(jCode + exitAt[e], &rel, 4);
+    jMovPtr(RAX, &vPC);
+    jMem(0, 0xC7, 0, RAX, NOREG, 0, 0);   // mov dword [vPC], pc
+    jInt(exitPc[e]);
+    jJmpTo(jLeave);
+  }
+  return jCode + start;
+}
+
+// run a compiled trace, returns once it has left the loop
+void jitRunTrace(void *trace) {
+  jitEnter(trace);
+}
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
@@ -40,7 +41,8 @@ symbol_t sLocalTable[NLOCAL];      // locals table
 type_t   sLocalType [NLOCAL];      // local type
 int      sLocalPos  [NLOCAL];      // stack offset of local
 int      sLocalSize [NLOCAL];      // local size (0=not array)
-int      sLocalSectSize;           // total locals size
+int      sLocalSectSize;           // size of the locals in scope
+int      sLocalFrameSize;          // largest locals size in the function
 
 symbol_t sSymPutchar;              // putchar system call symbol
 symbol_t sSymPuts;                 // puts system call symbol
@@ -51,6 +53,15 @@ symbol_t sSymMain;                 // main symbol
 
 int      cCode[NCODELEN];          // code stream
 int      cCodeLen;                 // code length
+int      cLast = -1;               // last instruction emitted (-1 unknown)
+int      cLabel;                   // last position taken as a jump target
+int      cPostInc;                 // old value recovery of a post increment
+int      cPostIncEnd = -1;         // end of that recovery
+int      cLogic;                   // operator of the last && or || value
+int      cLogicStart;              // start of its code
+int      cLogicTail;               // start of the tail making it a value
+int      cLogicEnd;                // end of the tail
+int      cLogicLabel;              // cLabel before the tail
 
 char     cStrTab[NSTRTABLEN];      // length of the string table
 int      cStrTabLen;               // current string table length
@@ -61,8 +72,28 @@ int      cConts;                   // number of continues
 int      cBreakStack[NBREAKS];     // break stack
 int      cBreaks;                  // number of breaks
 
+int      cCaseVal[NCASES];         // value of each case label
+int      cCasePos[NCASES];         // position of each case label
+int      cCases;                   // number of case labels
+int      cSwitch  = -1;            // first case of the innermost switch
+int      cDefault = -1;            // default label of the innermost switch
+
+int      cTailCalls[NTAILCALLS];   // calls of the function being returned
+int      cTailCallCount;           // number of those calls
+
+int      cConstStore[NCONSTS];     // stores initializing locals to constants
+int      cConstCount;              // number of those stores
+
+bool     cTarget[NCODELEN + 1];    // positions something jumps or calls to
+bool     cDead  [NCODELEN + 1];    // instructions removed by cOptimize
+int      cMoved [NCODELEN + 1];    // position of each word after cOptimize
+
 FILE    *inFile;                   // input file
 
+// a copy of code to emit again made by cCopy.  it starts with the position
+// copied from, the length and the emit state at its end, then the code
+#define COPYHEAD 9
+
 //----------------------------------------------------------------------------
 // FORWARD DECLARATIONS
 //----------------------------------------------------------------------------
@@ -72,10 +103,35 @@ void  pStmt       ();
 void  pParseLocal();
 void  cEmit0      (int c);
 int   cEmit1      (int c, int opr);
+void  cEmitDeref  ();
+void  cEmitInc    (int k);
+void  cEmitDrop   ();
+void  cEmitUnary  (int ins, int from);
+void  cEmitBinary (int ins, int lhs, int rhs);
+int   cEmitCond   (int ins, int opr, int from);
+bool  cConstSince (int from, int *k);
+void  cDelete     (int at, int words);
+int   cLastVar    ();
+int   cStoreOf    (int ins);
+int   cEmitJump   (int ins, int opr);
+int   cJoin       (int list, int other);
+int   cEmitSwitch (int first, int last, int dflt);
+bool  cPure       (int from, int to);
+void  cEmitSelect (int at, int a, int aEnd, int b, int bEnd, int label);
+int   cAssignBegin(int *slot);
+void  cAssignEnd  (int ins, int slot);
 void  cPatch      (int loc, int opr);
+bool  cCopy       (int from, int *buf);
+void  cEmitCopy   (int *buf);
+bool  cIsJump     (int ins);
 int   cPos        ();
 void  cPushSymbol (symbol_t s);
 void  cFixupBreaks(int i, int opr);
+void  cEmitTailCalls(int start);
+void  cConstLocal (int store);
+void  cPropagate  (int start);
+void  cReach      ();
+void  cOptimize   ();
 void  cFixupConts (int i, int opr);
 
 //----------------------------------------------------------------------------
@@ -123,14 +179,17 @@ token_t tKeywordCheck() {
   switch (tSym[0]) {
   case 'b': CHECK("break",    TOK_BREAK);    break;
   case 'c': CHECK("char",     TOK_CHAR);
+            CHECK("case",     TOK_CASE);
             CHECK("continue", TOK_CONTINUE); break;
-  case 'd': CHECK("do",       TOK_DO);       break;
+  case 'd': CHECK("do",       TOK_DO);
+            CHECK("default",  TOK_DEFAULT);  break;
   case 'e': CHECK("else",     TOK_ELSE);     break;
   case 'f': CHECK("for",      TOK_FOR);      break;
   case 'i': CHECK("int",      TOK_INT);
             CHECK("if",       TOK_IF);       break;
   case 'v': CHECK("void",     TOK_VOID);     break;
   case 'r': CHECK("return",   TOK_RETURN);   break;
+  case 's': CHECK("switch",   TOK_SWITCH);   break;
   case 'w': CHECK("while",    TOK_WHILE);    break;
   }
   return TOK_SYMBOL;
@@ -248,23 +307,32 @@ token_t tNext() {
   // try simple tokens
   switch (c) {
   case '\0': return tToken = TOK_EOF;
-  case '/':  return tToken = TOK_DIV;
-  case '*':  return tToken = TOK_MUL;
+  case '/':  return tToken = lFound('=') ? TOK_DIVASSIGN : TOK_DIV;
+  case '*':  return tToken = lFound('=') ? TOK_MULASSIGN : TOK_MUL;
   case ';':  return tToken = TOK_SEMI;
+  case ':':  return tToken = TOK_COLON;
+  case '?':  return tToken = TOK_QUESTION;
   case '(':  return tToken = TOK_LPAREN;
   case ')':  return tToken = TOK_RPAREN;
   case ',':  return tToken = TOK_COMMA;
   case '{':  return tToken = TOK_LBRACE;
   case '}':  return tToken = TOK_RBRACE;
-  case '%':  return tToken = TOK_MOD;
+  case '%':  return tToken = lFound('=') ? TOK_MODASSIGN : TOK_MOD;
   case '[':  return tToken = TOK_LBRACK;
   case ']':  return tToken = TOK_RBRACK;
-  case '<':  return tToken = lFound('=') ? TOK_LTEQU  : TOK_LT;
-  case '>':  return tToken = lFound('=') ? TOK_GTEQU  : TOK_GT;
-  case '|':  return tToken = lFound('|') ? TOK_LOGOR  : TOK_BITOR;
-  case '&':  return tToken = lFound('&') ? TOK_LOGAND : TOK_BITAND;
-  case '+':  return tToken = lFound('+') ? TOK_INC    : TOK_ADD;
-  case '-':  return tToken = lFound('-') ? TOK_DEC    : TOK_SUB;
+  case '^':  return tToken = lFound('=') ? TOK_XORASSIGN : TOK_BITXOR;
+  case '<':  return tToken = lFound('<') ? (lFound('=') ? TOK_SHLASSIGN : TOK_SHL) :
+                             lFound('=') ? TOK_LTEQU  : TOK_LT;
+  case '>':  return tToken = lFound('>') ? (lFound('=') ? TOK_SHRASSIGN : TOK_SHR) :
+                             lFound('=') ? TOK_GTEQU  : TOK_GT;
+  case '|':  return tToken = lFound('|') ? TOK_LOGOR  :
+                             lFound('=') ? TOK_ORASSIGN  : TOK_BITOR;
+  case '&':  return tToken = lFound('&') ? TOK_LOGAND :
+                             lFound('=') ? TOK_ANDASSIGN : TOK_BITAND;
+  case '+':  return tToken = lFound('+') ? TOK_INC    :
+                             lFound('=') ? TOK_ADDASSIGN : TOK_ADD;
+  case '-':  return tToken = lFound('-') ? TOK_DEC    :
+                             lFound('=') ? TOK_SUBASSIGN : TOK_SUB;
   case '=':  return tToken = lFound('=') ? TOK_EQU    : TOK_ASSIGN;
   case '!':  return tToken = lFound('=') ? TOK_NEQU   : TOK_LOGNOT;
   }
@@ -394,11 +462,19 @@ void sLocalAdd(type_t type, symbol_t sym, int size) {
 
   int allocSize = (size == 0) ? 1 : size;
 
+  // a slot taken over from a closed block holds more than one local
+  for (int i=0; i<cConstCount; ++i) {
+    int slot = cConstStore[i] >= 0 ? cCode[cConstStore[i] + 1] : -1;
+    if (slot >= sLocalSectSize && slot < sLocalSectSize + allocSize) {
+      cConstStore[i] = -1;
+    }
+  }
+
   sLocalSectSize += allocSize;
   sLocals++;
 
-  // allocate a new local
-  cEmit1(INS_ALLOC, allocSize);
+  if (sLocalSectSize > sLocalFrameSize)
+    sLocalFrameSize = sLocalSectSize;
 }
 
 // check if a symbol is a system call
@@ -517,25 +593,36 @@ bool pExprPrimary() {
 // the precedence table
 int pPrec(token_t c) {
   switch (c) {
-  case TOK_ASSIGN: return 1;
-  case TOK_LOGOR:  return 2;
-  case TOK_LOGAND: return 3;
-  case TOK_BITOR:  return 4;
-//case TOK_BITXOR: ...
-  case TOK_BITAND: return 5;
+  case TOK_ASSIGN:
+  case TOK_ADDASSIGN:
+  case TOK_SUBASSIGN:
+  case TOK_MULASSIGN:
+  case TOK_DIVASSIGN:
+  case TOK_MODASSIGN:
+  case TOK_ORASSIGN:
+  case TOK_ANDASSIGN:
+  case TOK_XORASSIGN:
+  case TOK_SHLASSIGN:
+  case TOK_SHRASSIGN: return 1;
+  case TOK_QUESTION: return 2;
+  case TOK_LOGOR:  return 3;
+  case TOK_LOGAND: return 4;
+  case TOK_BITOR:  return 5;
+  case TOK_BITXOR: return 6;
+  case TOK_BITAND: return 7;
   case TOK_NEQU:
-  case TOK_EQU:    return 6;
+  case TOK_EQU:    return 8;
   case TOK_LTEQU:
   case TOK_GTEQU:
   case TOK_LT:
-  case TOK_GT:     return 7;
-//case TOK_SHR: ...
-//case TOK_SHL: ...
+  case TOK_GT:     return 9;
+  case TOK_SHR:
+  case TOK_SHL:    return 10;
   case TOK_ADD:
-  case TOK_SUB:    return 8;
+  case TOK_SUB:    return 11;
   case TOK_MOD:
   case TOK_MUL:
-  case TOK_DIV:    return 9;
+  case TOK_DIV:    return 12;
   }
   return 0;
 }
@@ -551,6 +638,17 @@ int pPrec(token_t c) {
 bool pPrecCheck(int op, int minPrec) {
   switch (op) {
   case TOK_ASSIGN:
+  case TOK_ADDASSIGN:
+  case TOK_SUBASSIGN:
+  case TOK_MULASSIGN:
+  case TOK_DIVASSIGN:
+  case TOK_MODASSIGN:
+  case TOK_ORASSIGN:
+  case TOK_ANDASSIGN:
+  case TOK_XORASSIGN:
+  case TOK_SHLASSIGN:
+  case TOK_SHRASSIGN:
+  case TOK_QUESTION:
     return pPrec(op) <  minPrec;
   default:
     return pPrec(op) <= minPrec;
@@ -573,15 +671,15 @@ token_t pUnaryOpCheck() {
   return 0;
 }
 
-// apply a unary operation
+// apply a unary operation to the operand emitted from 'from'
 // return true if lvalue or false if rvalue
-bool pUnaryOpApply(bool lvalue, token_t op) {
+bool pUnaryOpApply(bool lvalue, token_t op, int from) {
 
   // dereference
   if (op == TOK_MUL) {
     // convert to rvalue
     if (lvalue) {
-      cEmit0(INS_DEREF);
+      cEmitDeref();
     }
     // dont apply a dereference just say its an lvalue
     return true;
@@ -600,21 +698,20 @@ bool pUnaryOpApply(bool lvalue, token_t op) {
   if (op == TOK_SUB) {
     // convert to rvalue
     if (lvalue) {
-      cEmit0(INS_DEREF);
+      cEmitDeref();
     }
     // negate the value
-    cEmit0(INS_NEG);
+    cEmitUnary(INS_NEG, from);
     // its an rvalue now
     return false;
   }
 
   // pre-increment, pre-decrement
   if (op == TOK_INC || op == TOK_DEC) {
-    cEmit0(INS_DUP);
-    cEmit0(INS_DEREF);
-    cEmit1(INS_CONST, 1);
-    cEmit0(op == TOK_INC ? TOK_ADD : TOK_SUB);
-    cEmit0(TOK_ASSIGN);
+    if (!lvalue) {
+      fatal("%u: pre increment requires lvalue", lLine);
+    }
+    cEmitInc(op == TOK_INC ? 1 : -1);
     // its an rvalue now
     return false;
   }
@@ -622,9 +719,9 @@ bool pUnaryOpApply(bool lvalue, token_t op) {
   // logical not
   if (op == TOK_LOGNOT) {
     if (lvalue) {
-      cEmit0(INS_DEREF);
+      cEmitDeref();
     }
-    cEmit0(TOK_LOGNOT);
+    cEmitUnary(TOK_LOGNOT, from);
     // its an rvalue now
     return false;
   }
@@ -637,7 +734,7 @@ void pSubscript(bool lvalue) {
   // to apply a subscript to something, it must be an rvalue or we will be
   // modifying the wrong address.  dereference it to an rvalue first.
   if (lvalue) {
-    cEmit0(INS_DEREF);
+    cEmitDeref();
   }
   pExpr(0, true);
   tExpect(TOK_RBRACK);
@@ -650,17 +747,12 @@ bool pExprPostInc(bool lvalue) {
     if (!lvalue) {
       fatal("%u: post increment requires lvalue", lLine);
     }
-    cEmit0(INS_DUP);      // duplicate lvalue
-    cEmit0(INS_DEREF);    // get the old value (as rvalue)
-    cEmit0(INS_SWAP);     // bring lvalue to top again
-    cEmit0(INS_DUP);      // duplicate for lhs and rhs
-    cEmit0(INS_DEREF);
-    cEmit1(INS_CONST, 1);
-    cEmit0(tToken == TOK_INC ? TOK_ADD : // lhs = rhs + 1
-                               TOK_SUB); // lhs = rhs - 1
-    cEmit0(TOK_ASSIGN);
-    cEmit0(INS_DROP);     // remove result of assignment
-                          // this leaves the old result on the top
+    int k = (tToken == TOK_INC) ? 1 : -1;
+    cEmitInc(k);          // lhs = lhs + k
+    cPostInc = cCodeLen;  // the old value is the new one less k,
+    cEmit1(INS_CONST, k); // cEmitDrop removes this if it isnt used
+    cEmit0(TOK_SUB);
+    cPostIncEnd = cCodeLen;
     // rvalue is returned
     return false;
   }
@@ -668,9 +760,121 @@ bool pExprPostInc(bool lvalue) {
   return lvalue;
 }
 
+// return the operator of a compound assignment or 0
+token_t pCompoundOp(token_t op) {
+  switch (op) {
+  case TOK_ADDASSIGN: return TOK_ADD;
+  case TOK_SUBASSIGN: return TOK_SUB;
+  case TOK_MULASSIGN: return TOK_MUL;
+  case TOK_DIVASSIGN: return TOK_DIV;
+  case TOK_MODASSIGN: return TOK_MOD;
+  case TOK_ORASSIGN:  return TOK_BITOR;
+  case TOK_ANDASSIGN: return TOK_BITAND;
+  case TOK_XORASSIGN: return TOK_BITXOR;
+  case TOK_SHLASSIGN: return TOK_SHL;
+  case TOK_SHRASSIGN: return TOK_SHR;
+  default:            return 0;
+  }
+}
+
+// apply a compound assignment with operator 'op' to the lvalue just pushed
+void pExprCompound(token_t op) {
+  int var = cLastVar();
+  int at  = cLast;
+
+  // additions go through ADDASSIGN or an increment for constants
+  if (op == TOK_ADD || op == TOK_SUB) {
+    int from = cCodeLen;
+    pExpr(pPrec(TOK_ASSIGN), true);
+    int k;
+    if (var && cConstSince(from, &k) && k >= -0x7fff && k <= 0x7fff) {
+      cDelete(cLast, 2);
+      cLast = at;
+      cEmitInc(op == TOK_ADD ? k : -k);
+      return;
+    }
+    if (op == TOK_SUB) {
+      if (cConstSince(from, &k) && k != INT_MIN) {
+        cCode[cLast + 1] = -k;
+      }
+      else {
+        cEmit0(INS_NEG);
+      }
+    }
+    cEmit0(INS_ADDASSIGN);
+    return;
+  }
+
+  // a plain variable is loaded and stored back directly
+  if (var) {
+    int slot = cCode[at + 1];
+    cEmitDeref();
+    pExpr(pPrec(TOK_ASSIGN), true);
+    cEmit0(op);
+    cEmit1(cStoreOf(var), slot);
+    return;
+  }
+  cEmit0(INS_DUP);
+  cEmit0(INS_DEREF);
+  pExpr(pPrec(TOK_ASSIGN), true);
+  cEmit0(op);
+  cEmit0(TOK_ASSIGN);
+}
+
+// emit the value of a chain of && or || operators starting at 'start'.  each
+// operand jumps to the tail as soon as it decides the result, cEmitJump can
+// take the tail back out when the value is only used as a condition
+void pExprLogical(token_t op, int start) {
+  int jump = (op == TOK_LOGAND) ? INS_JZ : INS_JNZ;
+  int list = cEmitJump(jump, -1);
+  do {
+    pExpr(pPrec(op), true);
+    list = cJoin(list, cEmitJump(jump, -1));
+  } while (tFound(op));
+
+  int label = cLabel;
+  int tail  = cCodeLen;
+  cEmit1(INS_CONST, op == TOK_LOGAND);
+  int end = cEmit1(INS_JMP, -1);
+  cPatch(list, cPos());
+  cEmit1(INS_CONST, op == TOK_LOGOR);
+  cPatch(end, cPos());
+
+  cLogic      = op;
+  cLogicStart = start;
+  cLogicTail  = tail;
+  cLogicEnd   = cCodeLen;
+  cLogicLabel = label;
+}
+
+// parse the arms of a conditional operator with the condition on the stack.
+// cheap arms which can't fault are both evaluated and one picked by SELECT,
+// otherwise only the arm chosen is run
+void pExprCond() {
+  int jf    = cEmitJump(INS_JZ, -1);  // ---> target false
+  int label = cLabel;
+  // the condition ends in a single jump nothing else goes past
+  bool single = cCode[jf] < 0 && cLabel < cCodeLen;
+  int a = cCodeLen;
+  pExpr(0, true);                     // <expr>
+  tExpect(TOK_COLON);                 // :
+  int je = cEmit1(INS_JMP, -1);       // ---> target end
+  cPatch(jf, cPos());                 // <--- target false
+  int b = cCodeLen;
+  pExpr(pPrec(TOK_QUESTION), true);   // <expr>
+  int end = cCodeLen;
+  cPatch(je, cPos());                 // <--- target end
+  cLogic = 0;                         // an && or || arm isnt the value
+
+  if (single && cPure(a, je - 1) && cPure(b, end)) {
+    cEmitSelect(jf - 1, a, je - 1, b, end, label);
+  }
+}
+
 // precedence climbing expression parser
 bool pExpr(int minPrec, bool rvalueReq) {
   bool lvalue;
+  int  start = cCodeLen;
 
   // check if we have any unary ops to consume
   token_t unOp = pUnaryOpCheck();
@@ -690,7 +894,7 @@ bool pExpr(int minPrec, bool rvalueReq) {
   lvalue = pExprPostInc(lvalue);
 
   // apply any unary op, if we found one
-  lvalue = pUnaryOpApply(lvalue, unOp);
+  lvalue = pUnaryOpApply(lvalue, unOp, start);
 
   // while our operator is equal or higher precidence
   while (1) {
@@ -707,30 +911,69 @@ bool pExpr(int minPrec, bool rvalueReq) {
     // consume operator
     tNext();
 
+    // short circuit operators
+    if (op == TOK_LOGAND || op == TOK_LOGOR) {
+      if (lvalue) {
+        cEmitDeref();
+      }
+      pExprLogical(op, start);
+      lvalue = false;
+      continue;
+    }
+
+    // conditional operator
+    if (op == TOK_QUESTION) {
+      if (lvalue) {
+        cEmitDeref();
+      }
+      pExprCond();
+      lvalue = false;
+      continue;
+    }
+
+    // compound assignment
+    token_t binop = pCompoundOp(op);
+    if (binop) {
+      if (!lvalue) {
+        fatal("%u: error: assignment requires lvalue", lLine);
+      }
+      pExprCompound(binop);
+      lvalue = false;
+      continue;
+    }
+
     // dereference if needed
+    int ins = 0, slot = 0;
     if (op == TOK_ASSIGN) {
       if (!lvalue) {
         fatal("%u: error: assignment requires lvalue", lLine);
       }
+      ins = cAssignBegin(&slot);
     }
     else {
       if (lvalue) {
-        cEmit0(INS_DEREF);
+        cEmitDeref();
       }
     }
 
     // rhs
+    int rhs = cCodeLen;
     pExpr(pPrec(op), true);
 
     // apply operator
-    cEmit0(op);
+    if (op == TOK_ASSIGN) {
+      cAssignEnd(ins, slot);
+    }
+    else {
+      cEmitBinary(op, start, rhs);
+    }
     lvalue = false;
   }
 
   // ensure evaluated expression is rvalue if required
   if (lvalue && rvalueReq) {
     lvalue = false;
-    cEmit0(INS_DEREF);
+    cEmitDeref();
   }
   return lvalue;
 }
@@ -756,6 +999,9 @@ type_t pType() {
 
 // parse a break statement
 void pStmtBreak() {
+  if (cBreaks >= NBREAKS) {
+    fatal("%u: error: break count limit reached", lLine);
+  }
   int opr = cEmit1(INS_JMP, -1);
   cBreakStack[cBreaks++] = opr;
 }
@@ -770,9 +1016,10 @@ void pStmtContinue() {
 void pStmtIf() {
                                   // if
   tExpect(TOK_LPAREN);            // (
+  int from = cCodeLen;
   pExpr(0, true);                 // <expr>
   tExpect(TOK_RPAREN);            // )
-  int tf = cEmit1(INS_JZ, -1);    // ---> target false  (JZ)
+  int tf = cEmitCond(INS_JZ, -1, from); // ---> target false  (JZ)
   pStmt();                        // <stmt>
   if (tFound(TOK_ELSE)) {         // else
     int te = cEmit1(INS_JMP, -1); // ---> target end    (JMP)
@@ -790,27 +1037,47 @@ void pStmtReturn() {
                                   // return
   pExpr(0, true);                 // <expr>
   tExpect(TOK_SEMI);              // ;
+  // a call returned directly may become a tail call, see cEmitTailCalls
+  if (cLast >= cLabel && cCode[cLast] == INS_CALL &&
+      cTailCallCount < NTAILCALLS) {
+    cTailCalls[cTailCallCount++] = cLast;
+  }
   cEmit1(INS_RETURN, sArgs);
 }
 
 // parse a while statement
+//
+// the condition guards the loop and is emitted again after the body, where
+// it jumps back to the top.  each iteration then takes a single branch.  a
+// condition too long to copy is only tested at the top
 void pStmtWhile() {
 
   int breaks = cBreaks;
   int conts  = cConts;
+  int cond[COPYHEAD + NLOOPCOPY];
 
-  int tt = cPos();                // <--- target top
+  int from = cPos();
                                   // while
   tExpect(TOK_LPAREN);            // (
   pExpr(0, true);                 // <expr>
   tExpect(TOK_RPAREN);            // )
-  int tf = cEmit1(INS_JZ, -1);    // ---> target false  (JZ)
+  bool rotate = cCopy(from, cond);
+  int tf = cEmitCond(INS_JZ, -1, from); // ---> target false  (JZ)
+  int tt = cPos();                // <--- target top
   pStmt();                        // <stmt>
-  cEmit1(INS_JMP, tt);            // ---> target top    (JMP)
+  int tc = from;                  // <--- continues go here
+  if (rotate) {
+    tc = cPos();
+    cEmitCopy(cond);              // <expr>
+    cEmitCond(INS_JNZ, tt, tc);   // ---> target top    (JNZ)
+  }
+  else {
+    cEmit1(INS_JMP, from);        // ---> condition     (JMP)
+  }
   cPatch(tf, cPos());             // <--- target false
 
   cFixupBreaks(breaks, cPos());  // <--- breaks go here
-  cFixupConts(conts, tt);
+  cFixupConts(conts, tc);
   cBreaks = breaks;
   cConts  = conts;
 }
@@ -837,7 +1104,7 @@ void pStmtDo() {
   pExpr(0, true);                 // <expr>
   tExpect(TOK_RPAREN);            // )
   tExpect(TOK_SEMI);              // ;
-  cEmit1(INS_JNZ, tt);            // ---> target top  (JNZ)
+  cEmitCond(INS_JNZ, tt, cond);   // ---> target top  (JNZ)
 
   cFixupBreaks(breaks, cPos());  // <--- breaks go here
   cFixupConts(conts, cond);
@@ -845,15 +1112,23 @@ void pStmtDo() {
   cConts  = conts;
 }
 
+// parse a for statement
+//
+// laid out like a while loop, the increment is taken back out after it is
+// parsed and emitted again after the body.  if either is too long to copy
+// the body is jumped to over the increment, which jumps back to the test
 void pStmtFor() {
 
   int breaks = cBreaks;
   int conts  = cConts;
+  int cond[COPYHEAD + NLOOPCOPY];
+  int inc [COPYHEAD + NLOOPCOPY];
 
   tExpect(TOK_LPAREN);            // (
   if (!tFound(TOK_SEMI)) {
     pExpr(0, true);               // <expr>
     tExpect(TOK_SEMI);            // ;
+    cEmitDrop();                  // rvalue not used
   }
   int locCond = cPos();           // .Lcond
   if (!tFound(TOK_SEMI)) {
@@ -863,18 +1138,40 @@ void pStmtFor() {
   else {
     cEmit1(INS_CONST, 1);
   }
-  int jmpBody = cEmit1(INS_JNZ, -1);  // .Lbody
-  int jmpEnd  = cEmit1(INS_JMP, -1);  // .Lend
-  int locInc  = cPos();           // .Linc
+  bool rotate = cCopy(locCond, cond);
+  int jmpEnd  = cEmitCond(INS_JZ, -1, locCond);  // ---> .Lend
+  int jmpBody = cEmit1(INS_JMP, -1);  // ---> .Lbody
 
+  int locInc = cPos();            // .Linc
   if (!tFound(TOK_RPAREN)) {
     pExpr(0, true);               // <expr>
     tExpect(TOK_RPAREN);          // )
+    cEmitDrop();                  // rvalue not used
+  }
+  if (rotate && cCopy(locInc, inc)) {
+    cCodeLen    = jmpBody - 1;
+    cLast       = -1;
+    cLogic      = 0;
+    cPostIncEnd = -1;
   }
-  cEmit1(INS_JMP, locCond);       // ---> .lCond
-  cPatch(jmpBody, cPos());        // .Lbody
+  else {
+    rotate = false;
+    cEmit1(INS_JMP, locCond);     // ---> .Lcond
+    cPatch(jmpBody, cCodeLen);
+  }
+
+  int locBody = cPos();           // .Lbody
   pStmt();                        // <stmt>
-  cEmit1(INS_JMP, locInc);        // ---> .Linc
+  if (rotate) {
+    locInc = cPos();              // .Linc
+    cEmitCopy(inc);               // <expr>
+    locCond = cCodeLen;
+    cEmitCopy(cond);              // <expr>
+    cEmitCond(INS_JNZ, locBody, locCond);  // ---> .Lbody
+  }
+  else {
+    cEmit1(INS_JMP, locInc);      // ---> .Linc
+  }
   cPatch(jmpEnd, cPos());         // .Lend
 
   cFixupBreaks(breaks, cPos());
@@ -883,6 +1180,75 @@ void pStmtFor() {
   cConts  = conts;
 }
 
+// parse a switch statement
+//
+// the body is emitted first while the value waits on the stack, then the
+// dispatch which jumps to the case labels found in it
+void pStmtSwitch() {
+
+  int breaks       = cBreaks;
+  int outerSwitch  = cSwitch;
+  int outerDefault = cDefault;
+                                  // switch
+  tExpect(TOK_LPAREN);            // (
+  pExpr(0, true);                 // <expr>
+  tExpect(TOK_RPAREN);            // )
+  int td = cEmit1(INS_JMP, -1);   // ---> target dispatch (JMP)
+  cSwitch  = cCases;
+  cDefault = -1;
+  pStmt();                        // <stmt>
+  int te = cEmit1(INS_JMP, -1);   // ---> target end    (JMP)
+  cPatch(td, cPos());             // <--- target dispatch
+  te = cJoin(te, cEmitSwitch(cSwitch, cCases, cDefault));
+  cPatch(te, cPos());             // <--- target end
+
+  cFixupBreaks(breaks, cPos());   // <--- breaks go here
+  cBreaks  = breaks;
+  cCases   = cSwitch;
+  cSwitch  = outerSwitch;
+  cDefault = outerDefault;
+}
+
+// parse a case label
+void pStmtCase() {
+                                  // case
+  if (cSwitch < 0) {
+    fatal("%u: error: case label not within a switch", lLine);
+  }
+  if (cCases >= NCASES) {
+    fatal("%u: error: case count limit reached", lLine);
+  }
+  int from = cCodeLen;
+  int value;
+  pExpr(0, true);                 // <constant expr>
+  if (!cConstSince(from, &value)) {
+    fatal("%u: error: case label is not a constant", lLine);
+  }
+  cCodeLen = from;
+  cLast    = -1;
+  tExpect(TOK_COLON);             // :
+  for (int i=cSwitch; i<cCases; ++i) {
+    if (cCaseVal[i] == value) {
+      fatal("%u: error: duplicate case value %d", lLine, value);
+    }
+  }
+  cCaseVal[cCases]   = value;
+  cCasePos[cCases++] = cPos();    // <--- case target
+}
+
+// parse a default label
+void pStmtDefault() {
+                                  // default
+  tExpect(TOK_COLON);             // :
+  if (cSwitch < 0) {
+    fatal("%u: error: default label not within a switch", lLine);
+  }
+  if (cDefault >= 0) {
+    fatal("%u: error: multiple default labels in one switch", lLine);
+  }
+  cDefault = cPos();              // <--- default target
+}
+
 // parse a statement
 void pStmt() {
   // parse a local var decl
@@ -916,6 +1282,19 @@ void pStmt() {
     pStmtFor();
     return;
   }
+  // switch statement and its labels
+  if (tFound(TOK_SWITCH)) {
+    pStmtSwitch();
+    return;
+  }
+  if (tFound(TOK_CASE)) {
+    pStmtCase();
+    return;
+  }
+  if (tFound(TOK_DEFAULT)) {
+    pStmtDefault();
+    return;
+  }
   // continue
   if (tFound(TOK_CONTINUE)) {
     pStmtContinue();
@@ -929,12 +1308,14 @@ void pStmt() {
   // compound statement
   if (tFound(TOK_LBRACE)) {
     // save number of locals
-    int numLoc = sLocals;
+    int numLoc  = sLocals;
+    int sectLoc = sLocalSectSize;
     while (!tFound(TOK_RBRACE)) {
       pStmt();
     }
-    // restore number of locals
-    sLocals = numLoc;
+    // restore number of locals, later blocks reuse their slots
+    sLocals        = numLoc;
+    sLocalSectSize = sectLoc;
     return;
   }
   // empty statement
@@ -945,7 +1326,7 @@ void pStmt() {
   pExpr(0, true);
   tExpect(TOK_SEMI);
   // rvalue not used
-  cEmit0(INS_DROP);
+  cEmitDrop();
 }
 
 // parse a global decl
@@ -974,17 +1355,37 @@ void pParseLocal() {
       tExpect(TOK_RBRACK);
     }
 
+    // no other local has used its slot before
+    int  pos   = sLocalSectSize;
+    int  used  = sLocalFrameSize;
+    bool fresh = pos == used;
     sLocalAdd(type, sym, size);
 
     if (tFound(TOK_ASSIGN)) {
       if (size > 0) {
         fatal("%u: error: cant initialize array", lLine);
       }
+      int slot, k;
       cPushSymbol(sym);
+      int ins  = cAssignBegin(&slot);
+      int from = cCodeLen;
       pExpr(0, true);
-      cEmit0(TOK_ASSIGN);
+      bool known = cConstSince(from, &k);
+      cAssignEnd(ins, slot);
+      if (known && fresh) {
+        cConstLocal(cLast);
+      }
       cEmit0(INS_DROP);
     }
+    else {
+      // ENTER only zeroes the slots once, so those a closed block left a
+      // value in are zeroed again
+      for (int i=pos; i<used && i<sLocalSectSize; ++i) {
+        cEmit1(INS_CONST, 0);
+        cEmit1(INS_STOREL, i);
+        cEmit0(INS_DROP);
+      }
+    }
 
   } while (tFound(TOK_COMMA));
   tExpect(TOK_SEMI);
@@ -994,9 +1395,10 @@ void pParseLocal() {
 void pParseFunc(type_t type, symbol_t sym) {
 
   // new scope so clear args and locals
-  sArgs          = 0;
-  sLocals        = 0;
-  sLocalSectSize = 0;
+  sArgs           = 0;
+  sLocals         = 0;
+  sLocalSectSize  = 0;
+  sLocalFrameSize = 0;
 
   // parse arguments
   if (!tFound(TOK_RPAREN)) {
@@ -1022,7 +1424,12 @@ void pParseFunc(type_t type, symbol_t sym) {
   // function body
   tExpect(TOK_LBRACE);
 
+  // one prologue allocates every local, patched once their size is known
+  int enter = cEmit1(INS_ENTER, -1);
+
   // parse statements
+  cTailCallCount = 0;
+  cConstCount    = 0;
   while (!tFound(TOK_RBRACE)) {
     pStmt();
   }
@@ -1030,6 +1437,11 @@ void pParseFunc(type_t type, symbol_t sym) {
   // return from function
   cEmit1(INS_CONST, 0);
   cEmit1(INS_RETURN, sArgs);
+
+  cPatch(enter, sLocalFrameSize);
+
+  cPropagate(sFuncPos[sFuncs - 1]);
+  cEmitTailCalls(sFuncPos[sFuncs - 1]);
 }
 
 void pParse() {
@@ -1056,28 +1468,446 @@ void pParse() {
 // CODEGEN
 //----------------------------------------------------------------------------
 
-// return current code stream position
+// return current code stream position, which is taken as a jump target
 int cPos() {
-  return cCodeLen;
+  return cLabel = cCodeLen;
 }
 
-// emit to output code stream
-void cEmit0(int ins) {
+// emit a word to output code stream
+void cEmitWord(int w) {
   if (cCodeLen >= NCODELEN)
     fatal("%u: error: code limit reached", lLine);
-  cCode[cCodeLen++] = ins;
+  cCode[cCodeLen++] = w;
+}
+
+// emit to output code stream
+void cEmit0(int ins) {
+  if (ins != INS_LINE) {
+    cLast = cCodeLen;
+  }
+  cEmitWord(ins);
 }
 
 // emit instruction and operand to code stream
 int cEmit1(int ins, int opr) {
   cEmit0(ins);
-  cEmit0(opr);
+  cEmitWord(opr);
   return cCodeLen - 1;
 }
 
+// remove 'words' words of code at 'at', only line markers may follow them
+void cDelete(int at, int words) {
+  for (int i=at + words; i<cCodeLen; ++i) {
+    cCode[i - words] = cCode[i];
+  }
+  cCodeLen -= words;
+}
+
+// return the variable address instruction emitted last or 0 if there is
+// none or something may jump in after it
+int cLastVar() {
+  if (cLast < 0 || cLast < cLabel) {
+    return 0;
+  }
+  switch (cCode[cLast]) {
+  case INS_GETAL:
+  case INS_GETAA:
+  case INS_GETAG:
+    return cCode[cLast];
+  }
+  return 0;
+}
+
+// return the store matching a variable address instruction
+int cStoreOf(int ins) {
+  switch (ins) {
+  case INS_GETAL: return INS_STOREL;
+  case INS_GETAA: return INS_STOREA;
+  default:        return INS_STOREG;
+  }
+}
+
+// true if the code from 'from' on is a single constant between line markers,
+// its value is returned in 'k'
+bool cConstSince(int from, int *k) {
+  if (cLast < from || cLast < cLabel || cCode[cLast] != INS_CONST) {
+    return false;
+  }
+  for (int i=from; i<cLast; i+=2) {
+    if (cCode[i] != INS_LINE) {
+      return false;
+    }
+  }
+  *k = cCode[cLast + 1];
+  return true;
+}
+
+// return the position of the only constant in the code from 'from' to 'to'
+// between line markers or -1 if there isn't one
+int cConstIn(int from, int to) {
+  int at = -1;
+  for (int i=from; i<to; i+=2) {
+    if (cCode[i] == INS_CONST && at < 0) {
+      at = i;
+    }
+    else if (cCode[i] != INS_LINE) {
+      return -1;
+    }
+  }
+  return at;
+}
+
+// emit a unary operator on the operand from 'from', folding a constant
+void cEmitUnary(int ins, int from) {
+  int k;
+  if (cConstSince(from, &k)) {
+    cCode[cLast + 1] = (ins == INS_NEG) ? (int)-(unsigned)k : !k;
+    return;
+  }
+  cEmit0(ins);
+}
+
+// emit a binary operator on the operands from 'lhs' and 'rhs', two
+// constants are folded into one unless that would fault
+void cEmitBinary(int ins, int lhs, int rhs) {
+  int a = cConstIn(lhs, rhs);
+  int b = cConstIn(rhs, cCodeLen);
+  int res;
+  if (a >= 0 && b >= 0 && a >= cLabel &&
+      insFold(ins, cCode[a + 1], cCode[b + 1], &res)) {
+    cCode[a + 1] = res;
+    cDelete(b, 2);
+    cLast = a;
+    return;
+  }
+  cEmit0(ins);
+}
+
+// emit the jump on a statement's condition, emitted from 'from', see
+// cEmitJump.  a constant condition becomes a JMP or no jump at all
+int cEmitCond(int ins, int opr, int from) {
+  int k;
+  if (!cConstSince(from, &k)) {
+    return cEmitJump(ins, opr);
+  }
+  cDelete(cLast, 2);
+  cLast = -1;
+  if ((k != 0) == (ins == INS_JNZ)) {
+    return cEmit1(INS_JMP, opr);
+  }
+  return -1;
+}
+
+// add 'k' to the lvalue just pushed leaving the new value.  a plain variable
+// is updated in place by a single increment instruction
+void cEmitInc(int k) {
+  int ins  = cLastVar();
+  int slot = ins ? cCode[cLast + 1] : -1;
+  if (slot >= 0 && slot <= 0xffff && k >= -0x8000 && k <= 0x7fff) {
+    switch (ins) {
+    case INS_GETAL: cCode[cLast] = INS_INCL; break;
+    case INS_GETAA: cCode[cLast] = INS_INCA; break;
+    case INS_GETAG: cCode[cLast] = INS_INCG; break;
+    }
+    cCode[cLast + 1] = INC_OPR(slot, k);
+    return;
+  }
+  cEmit1(INS_CONST, k);
+  cEmit0(INS_ADDASSIGN);
+}
+
+// emit a drop of an unused expression value.  if that is the old value
+// recovered by a post increment, emitted last, the recovery is removed again
+void cEmitDrop() {
+  if (cPostIncEnd == cCodeLen && cPostInc > cLabel &&
+      cLast == cPostIncEnd - 1 && cCode[cLast] == TOK_SUB) {
+    cCodeLen = cPostInc;
+    cLast    = -1;
+  }
+  cPostIncEnd = -1;
+  cEmit0(INS_DROP);
+}
+
+// true if the last instruction emitted adds an index to a base address and
+// nothing may jump in after it
+bool cLastIndex() {
+  return cLast >= 0 && cLast >= cLabel && cCode[cLast] == TOK_ADD;
+}
+
+// emit a dereference, a variable address pushed just before becomes a load
+// and a subscript an indexed load
+void cEmitDeref() {
+  switch (cLastVar()) {
+  case INS_GETAL: cCode[cLast] = INS_LOADL; return;
+  case INS_GETAA: cCode[cLast] = INS_LOADA; return;
+  case INS_GETAG: cCode[cLast] = INS_LOADG; return;
+  }
+  if (cLastIndex()) {
+    cCode[cLast] = INS_INDEX;
+    return;
+  }
+  cEmit0(INS_DEREF);
+}
+
+// return the conditional jump taken when 'ins' is not
+int cInvertJump(int ins) {
+  switch (ins) {
+  case INS_JZ:  return INS_JNZ;
+  case INS_JNZ: return INS_JZ;
+  case INS_JLT: return INS_JGE;
+  case INS_JGE: return INS_JLT;
+  case INS_JEQ: return INS_JNE;
+  case INS_JNE: return INS_JEQ;
+  case INS_JGT: return INS_JLE;
+  default:      return INS_JGT;
+  }
+}
+
+// jumps waiting for a target are kept in a list linked through their
+// operands and ended by -1, see cPatch.  append list 'other' to 'list'
+int cJoin(int list, int other) {
+  if (other < 0) {
+    return list;
+  }
+  int i = other;
+  while (cCode[i] >= 0) {
+    i = cCode[i];
+  }
+  cCode[i] = list;
+  return other;
+}
+
+// gather the conditional jumps in code from 'from' to 'to' which go to
+// 'target' into a list
+int cJumpsTo(int from, int to, int target) {
+  int list = -1;
+  for (int i=from; i<to; i+=insSize(cCode[i])) {
+    switch (cCode[i]) {
+    case INS_JZ:
+    case INS_JNZ:
+    case INS_JLT:
+    case INS_JGE:
+    case INS_JEQ:
+    case INS_JNE:
+    case INS_JGT:
+    case INS_JLE:
+      if (cCode[i + 1] == target) {
+        cCode[i + 1] = list;
+        list = i + 1;
+      }
+    }
+  }
+  return list;
+}
+
+// compare operators and the jumps they fuse into
+const int cJumps[][3] = {
+  // compare     jump if true  jump if false
+  { TOK_LT,      INS_JLT,      INS_JGE },
+  { TOK_GTEQU,   INS_JGE,      INS_JLT },
+  { TOK_EQU,     INS_JEQ,      INS_JNE },
+  { TOK_NEQU,    INS_JNE,      INS_JEQ },
+  { TOK_GT,      INS_JGT,      INS_JLE },
+  { TOK_LTEQU,   INS_JLE,      INS_JGT },
+};
+
+// emit a conditional jump, JZ or JNZ, and return the list of jumps to patch
+// with its target.  when the condition is a comparison emitted last it is
+// taken back out and fused into the jump.  when it is an && or || value the
+// jumps deciding it are sent to the target instead of producing the value
+int cEmitJump(int ins, int opr) {
+  if (cLogic && cLogicEnd == cCodeLen && cLabel == cCodeLen) {
+    // the operand jumps go to the tail producing the value they stand for
+    bool decides = (ins == INS_JNZ) == (cLogic == TOK_LOGOR);
+    int  value   = cLogicTail + 4;
+    int  last    = cLogicTail - 1;
+    int  list    = cJumpsTo(cLogicStart, last - 1, value);
+    cCodeLen = cLogicTail;
+    cLabel   = cLogicLabel;
+    cLast    = -1;
+    cLogic   = 0;
+    if (decides) {
+      // they all go to the target
+      cCode[last] = list;
+    }
+    else {
+      // falling through the last jump decides the other way, so it is
+      // inverted to go to the target and the others skip past it.  jumps
+      // in the last operand falling past it to the tail go there as well
+      cCode[last - 1] = cInvertJump(cCode[last - 1]);
+      cCode[last]     = cJumpsTo(cLogicStart, last - 1, cLogicTail);
+      cPatch(list, cPos());
+    }
+    if (opr >= 0) {
+      cPatch(last, opr);
+    }
+    return last;
+  }
+
+  if (cLast >= 0 && cLast >= cLabel) {
+    for (int i=0; i<6; ++i) {
+      if (cCode[cLast] != cJumps[i][0]) {
+        continue;
+      }
+      cDelete(cLast, 1);
+      cLast = -1;
+      ins = cJumps[i][ins == INS_JZ ? 2 : 1];
+      break;
+    }
+  }
+  return cEmit1(ins, opr);
+}
+
+// true if the code from 'from' to 'to' is short, can't fault and has no
+// effect besides pushing one value, so it may run when it isn't needed
+bool cPure(int from, int to) {
+  int count = 0;
+  for (int i=from; i<to; i+=insSize(cCode[i])) {
+    switch (cCode[i]) {
+    case INS_LINE:
+      continue;
+    case INS_CONST:
+    case INS_STR:
+    case INS_GETAL:
+    case INS_GETAA:
+    case INS_GETAG:
+    case INS_LOADL:
+    case INS_LOADA:
+    case INS_LOADG:
+    case INS_NEG:
+    case INS_SELECT:
+    case TOK_LOGNOT:
+    case TOK_ADD:
+    case TOK_SUB:
+    case TOK_MUL:
+    case TOK_BITOR:
+    case TOK_BITAND:
+    case TOK_BITXOR:
+    case TOK_SHL:
+    case TOK_SHR:
+    case TOK_LT:
+    case TOK_GT:
+    case TOK_LTEQU:
+    case TOK_GTEQU:
+    case TOK_EQU:
+    case TOK_NEQU:
+      break;
+    default:
+      return false;
+    }
+    if (++count > 4) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// rewrite the conditional operator at 'at', the jump on its condition with
+// the arms 'a' and 'b' after it, to evaluate both arms and SELECT one.
+// 'label' is the last jump target before it
+void cEmitSelect(int at, int a, int aEnd, int b, int bEnd, int label) {
+  int to = at;
+  // a compare fused into the jump is put back
+  for (int i=0; i<6; ++i) {
+    if (cCode[at] == cJumps[i][2]) {
+      cCode[to++] = cJumps[i][0];
+    }
+  }
+  for (int i=a; i<aEnd; ++i) {
+    cCode[to++] = cCode[i];
+  }
+  for (int i=b; i<bEnd; ++i) {
+    cCode[to++] = cCode[i];
+  }
+  cCodeLen = to;
+  cLabel   = label;
+  cEmit0(INS_SELECT);
+}
+
+// start an assignment to the lvalue just pushed and return the instruction
+// to finish it with.  the address of a plain variable is taken back out so
+// the value can be stored to its slot directly, and the addition of a
+// subscript so it can be an indexed store
+int cAssignBegin(int *slot) {
+  int ins = cLastVar();
+  if (!ins) {
+    if (cLastIndex()) {
+      cDelete(cLast, 1);
+      cLast = -1;
+      return INS_STOREX;
+    }
+    return TOK_ASSIGN;
+  }
+  *slot = cCode[cLast + 1];
+  cDelete(cLast, 2);
+  cLast = -1;
+  return cStoreOf(ins);
+}
+
+// finish an assignment started by cAssignBegin
+void cAssignEnd(int ins, int slot) {
+  if (ins == TOK_ASSIGN || ins == INS_STOREX) {
+    cEmit0(ins);
+  }
+  else {
+    cEmit1(ins, slot);
+  }
+}
+
 // patch a previous operand
 void cPatch(int loc, int opr) {
-  cCode[loc] = opr;
+  // walk the list of jumps waiting for it, see cJoin
+  while (loc >= 0) {
+    int next = cCode[loc];
+    cCode[loc] = opr;
+    loc = next;
+  }
+}
+
+// copy the code emitted from 'from' into 'buf', which has room for a
+// header and NLOOPCOPY words.  false if the code doesn't fit
+bool cCopy(int from, int *buf) {
+  int len = cCodeLen - from;
+  if (len > NLOOPCOPY) {
+    return false;
+  }
+  int state[COPYHEAD] = {
+    from, len, cLast, cLabel,
+    cLogic, cLogicStart, cLogicTail, cLogicEnd, cLogicLabel
+  };
+  for (int i=0; i<COPYHEAD; ++i) {
+    buf[i] = state[i];
+  }
+  for (int i=0; i<len; ++i) {
+    buf[COPYHEAD + i] = cCode[from + i];
+  }
+  return true;
+}
+
+// emit a copy made by cCopy.  jumps within it are moved along with it and
+// the emit state is as it was after the original, so a jump on a condition
+// copied fuses with it just the same
+void cEmitCopy(int *buf) {
+  int from  = buf[0];
+  int len   = buf[1];
+  int at    = cCodeLen;
+  int delta = at - from;
+  for (int i=0; i<len; ++i) {
+    cEmitWord(buf[COPYHEAD + i]);
+  }
+  for (int i=at; i<cCodeLen; i+=insSize(cCode[i])) {
+    int to = cCode[i + 1];
+    if (cIsJump(cCode[i]) && to >= from && to <= from + len) {
+      cCode[i + 1] = to + delta;
+    }
+  }
+  cLast  = (buf[2] >= from) ? buf[2] + delta : -1;
+  cLabel = (buf[3] >= from) ? buf[3] + delta : cLabel;
+  cLogic = (buf[4] && buf[5] >= from) ? buf[4] : 0;
+  cLogicStart = buf[5] + delta;
+  cLogicTail  = buf[6] + delta;
+  cLogicEnd   = buf[7] + delta;
+  cLogicLabel = buf[8] + delta;
 }
 
 // lookup a symbol and push its value onto the stack
@@ -1101,6 +1931,155 @@ void cPushSymbol(symbol_t s) {
   fatal("%u: error: unknown identifier '%s'", lLine, sSymbolName(s));
 }
 
+// emit a JMP to 'to', or past the switch when it is -1 by adding it to the
+// list 'end'.  returns the list
+int cEmitCaseJump(int to, int end) {
+  if (to >= 0) {
+    cEmit1(INS_JMP, to);
+    return end;
+  }
+  return cJoin(end, cEmit1(INS_JMP, -1));
+}
+
+// binary search the 'n' sorted case values in 'val' for the switch value on
+// the stack, jumping to the matching label in 'pos' or to 'dflt'
+int cEmitSearch(int *val, int *pos, int n, int dflt, int end) {
+  if (n <= 3) {
+    // compare against what is left one at a time
+    for (int k=0; k<n; ++k) {
+      cEmit0(INS_DUP);
+      cEmit1(INS_CONST, val[k]);
+      int next = cEmit1(INS_JNE, -1);
+      cEmit0(INS_DROP);
+      cEmit1(INS_JMP, pos[k]);
+      cPatch(next, cPos());
+    }
+    cEmit0(INS_DROP);
+    return cEmitCaseJump(dflt, end);
+  }
+  int mid = n / 2;
+  cEmit0(INS_DUP);
+  cEmit1(INS_CONST, val[mid]);
+  int upper = cEmit1(INS_JGE, -1);
+  end = cEmitSearch(val, pos, mid, dflt, end);
+  cPatch(upper, cPos());
+  return cEmitSearch(val + mid, pos + mid, n - mid, dflt, end);
+}
+
+// emit the dispatch of the switch value on the stack to cases 'first' to
+// 'last' and the default label 'dflt', or past the switch if it is -1.
+// dense cases index a table of jumps and sparse ones are binary searched.
+// returns the list of jumps past the switch
+int cEmitSwitch(int first, int last, int dflt) {
+  int *val = cCaseVal + first;
+  int *pos = cCasePos + first;
+  int  n   = last - first;
+
+  // sort the cases by value
+  for (int i=1; i<n; ++i) {
+    int v = val[i];
+    int p = pos[i];
+    int j = i;
+    for (; j > 0 && val[j - 1] > v; --j) {
+      val[j] = val[j - 1];
+      pos[j] = pos[j - 1];
+    }
+    val[j] = v;
+    pos[j] = p;
+  }
+
+  // a table is used when at least half its entries are cases
+  long long range = (n > 0) ? (long long)val[n - 1] - val[0] + 1 : 0;
+  if (n < 4 || range > 2 * n) {
+    return cEmitSearch(val, pos, n, dflt, -1);
+  }
+  if (val[0] != 0) {
+    cEmit1(INS_CONST, val[0]);
+    cEmit0(TOK_SUB);
+  }
+  cEmit1(INS_SWITCH, range);
+  int end = -1;
+  for (int k=0, v=val[0]; k<n; ++v) {
+    if (val[k] == v) {
+      cEmit1(INS_JMP, pos[k++]);
+    }
+    else {
+      end = cEmitCaseJump(dflt, end);
+    }
+  }
+  return cEmitCaseJump(dflt, end);
+}
+
+// note the store at 'store' initializing a local to the constant before it
+void cConstLocal(int store) {
+  if (cConstCount < NCONSTS) {
+    cConstStore[cConstCount++] = store;
+  }
+}
+
+// the locals of the function starting at 'start' which are stored to once,
+// by their constant initializer, and never have their address taken hold
+// that constant wherever they are read, so their loads become constants
+void cPropagate(int start) {
+  for (int c=0; c<cConstCount; ++c) {
+    int store = cConstStore[c];
+    if (store < 0) {
+      continue;
+    }
+    int  slot = cCode[store + 1];
+    bool once = true;
+    for (int i=start; i<cCodeLen && once; i+=insSize(cCode[i])) {
+      switch (cCode[i]) {
+      case INS_GETAL:
+        once = cCode[i + 1] != slot;
+        break;
+      case INS_STOREL:
+        once = cCode[i + 1] != slot || i == store;
+        break;
+      case INS_INCL:
+        once = INC_SLOT(cCode[i + 1]) != slot;
+        break;
+      }
+    }
+    if (!once) {
+      continue;
+    }
+    // the constant is the last instruction before the store
+    int k = store - 2;
+    while (cCode[k] == INS_LINE) {
+      k -= 2;
+    }
+    for (int i=start; i<cCodeLen; i+=insSize(cCode[i])) {
+      if (cCode[i] == INS_LOADL && cCode[i + 1] == slot) {
+        cCode[i]     = INS_CONST;
+        cCode[i + 1] = cCode[k + 1];
+      }
+    }
+  }
+}
+
+// turn the calls returned directly in the function starting at 'start' into
+// tail calls, which reuse its frame.  not if it takes the address of an
+// argument or local anywhere, as the callee could still be using it
+void cEmitTailCalls(int start) {
+  for (int i=start; i<cCodeLen; i+=insSize(cCode[i])) {
+    if (cCode[i] == INS_GETAL || cCode[i] == INS_GETAA) {
+      return;
+    }
+  }
+  for (int i=0; i<cTailCallCount; ++i) {
+    int at = cTailCalls[i];
+    int to = cCode[at + 1];
+    int f  = 0;
+    while (sFuncPos[f] != to) {
+      ++f;
+    }
+    // the RETURN after it is left behind unreachable
+    cCode[at]     = INS_TAILCALL;
+    cCode[at + 1] = TAIL_OPR(to, sFuncArgs[f], sArgs);
+  }
+}
+
 void cFixupBreaks(int i, int opr) {
   for (;i < cBreaks; ++i) {
     cPatch(cBreakStack[i], opr);
@@ -1117,6 +2096,280 @@ void cFixupConts(int i, int opr) {
 // DRIVER
 //----------------------------------------------------------------------------
 
+// true if 'ins' is a jump with a code position for its operand
+bool cIsJump(int ins) {
+  switch (ins) {
+  case INS_JMP:
+  case INS_JZ:
+  case INS_JNZ:
+  case INS_JLT:
+  case INS_JGE:
+  case INS_JEQ:
+  case INS_JNE:
+  case INS_JGT:
+  case INS_JLE:
+    return true;
+  }
+  return false;
+}
+
+// the instruction at or after 'i' skipping line markers and removed code
+int cNext(int i) {
+  while (i < cCodeLen && (cDead[i] || cCode[i] == INS_LINE)) {
+    i += insSize(cCode[i]);
+  }
+  return i;
+}
+
+// remove the instruction at 'i', what jumps to it goes to the next one
+void cKill(int i) {
+  cDead[i] = true;
+  if (cTarget[i]) {
+    cTarget[cNext(i)] = true;
+  }
+}
+
+// true if 'ins' pushes a value and does nothing else
+bool cIsPush(int ins) {
+  switch (ins) {
+  case INS_CONST:
+  case INS_STR:
+  case INS_GETAL:
+  case INS_GETAA:
+  case INS_GETAG:
+  case INS_LOADL:
+  case INS_LOADA:
+  case INS_LOADG:
+    return true;
+  }
+  return false;
+}
+
+// return the load matching a store instruction or 0
+int cLoadOf(int ins) {
+  switch (ins) {
+  case INS_STOREL: return INS_LOADL;
+  case INS_STOREA: return INS_LOADA;
+  case INS_STOREG: return INS_LOADG;
+  default:         return 0;
+  }
+}
+
+// mark dead everything that can't be reached from the start of the code,
+// following jumps, calls and switch tables.  functions nothing calls go
+// with the rest
+void cReach() {
+  static int work[NCODELEN];
+  static bool seen[NCODELEN + 1];
+  int works = 0;
+  work[works++] = 0;
+  seen[0] = true;
+  while (works) {
+    int i   = work[--works];
+    int ins = cCode[i];
+    int opr = cCode[i + 1];
+    int next[2] = { i + insSize(ins), -1 };
+    switch (ins) {
+    case INS_RETURN:
+      next[0] = -1;
+      break;
+    case INS_JMP:
+      next[0] = opr;
+      break;
+    case INS_TAILCALL:
+      next[0] = TAIL_TO(opr);
+      break;
+    case INS_CALL:
+      next[1] = opr;
+      // the bootstrap exits when main returns
+      if (i < sFuncPos[0]) {
+        next[0] = -1;
+      }
+      break;
+    case INS_SWITCH:
+      // each entry of the table is a JMP, the last follows them all
+      for (int k=0, j=i + 2; k<=opr; ++k, j+=2) {
+        j = cNext(j);
+        if (!seen[j]) {
+          seen[j] = true;
+          work[works++] = j;
+        }
+      }
+      next[0] = -1;
+      break;
+    default:
+      if (cIsJump(ins)) {
+        next[1] = opr;
+      }
+    }
+    for (int n=0; n<2; ++n) {
+      int j = (next[n] >= 0) ? cNext(next[n]) : cCodeLen;
+      if (j < cCodeLen && !seen[j]) {
+        seen[j] = true;
+        work[works++] = j;
+      }
+    }
+  }
+  for (int i=0; i<cCodeLen; i+=insSize(cCode[i])) {
+    if (cCode[i] != INS_LINE && !seen[i]) {
+      cDead[i] = true;
+    }
+  }
+}
+
+// peephole pass over the finished code.  jumps to jumps are threaded and
+// then a window slides over the code removing what is dead or undone right
+// after, until nothing changes.  the code is then closed up and every jump
+// and call moved with it
+void cOptimize() {
+  // send jumps straight to the end of a chain of jumps
+  for (int i=0; i<cCodeLen; i+=insSize(cCode[i])) {
+    if (!cIsJump(cCode[i])) {
+      continue;
+    }
+    int to = cCode[i + 1];
+    for (int n=0; n<16; ++n) {
+      int j = cNext(to);
+      if (j >= cCodeLen || cCode[j] != INS_JMP) {
+        break;
+      }
+      to = cCode[j + 1];
+    }
+    cCode[i + 1] = to;
+  }
+
+  cReach();
+
+  // find every instruction that may be jumped or called to, the entries of
+  // a switch table are reached by their position
+  for (int i=cNext(0); i<cCodeLen; i=cNext(i + insSize(cCode[i]))) {
+    int ins = cCode[i];
+    if (cIsJump(ins) || ins == INS_CALL) {
+      cTarget[cNext(cCode[i + 1])] = true;
+    }
+    if (ins == INS_TAILCALL) {
+      cTarget[cNext(TAIL_TO(cCode[i + 1]))] = true;
+    }
+    if (ins == INS_SWITCH) {
+      for (int k=0, j=i + 2; k<=cCode[i + 1]; ++k, j+=2) {
+        j = cNext(j);
+        cTarget[j] = true;
+      }
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i=cNext(0); i<cCodeLen; i=cNext(i + insSize(cCode[i]))) {
+      int ins = cCode[i];
+      int opr = cCode[i + 1];
+      int j   = cNext(i + insSize(ins));
+      int k   = (j < cCodeLen) ? cNext(j + insSize(cCode[j])) : cCodeLen;
+      bool jIn = j < cCodeLen && !cTarget[j];
+      bool kIn = k < cCodeLen && !cTarget[k];
+
+      // an empty prologue
+      if (ins == INS_ENTER && opr == 0) {
+        cKill(i);
+        changed = true;
+      }
+      // a value pushed only to be dropped
+      else if ((ins == INS_DUP || cIsPush(ins)) &&
+               jIn && cCode[j] == INS_DROP) {
+        cKill(i);
+        cKill(j);
+        changed = true;
+      }
+      // a value stored, dropped and loaded again stays where it is
+      else if (cLoadOf(ins) && jIn && cCode[j] == INS_DROP &&
+               kIn && cCode[k] == cLoadOf(ins) && cCode[k + 1] == opr) {
+        cKill(j);
+        cKill(k);
+        changed = true;
+      }
+      // a conditional jump over a jump is inverted to go where it does
+      else if (cIsJump(ins) && ins != INS_JMP && jIn &&
+               cCode[j] == INS_JMP && cNext(opr) == k) {
+        cCode[i]     = cInvertJump(ins);
+        cCode[i + 1] = cCode[j + 1];
+        cKill(j);
+        changed = true;
+      }
+      // a jump to the next instruction
+      if (ins == INS_JMP && !cTarget[i] && cNext(opr) == j) {
+        cKill(i);
+        changed = true;
+      }
+    }
+  }
+
+  // a function left without a return, as it loops forever, keeps the one
+  // ending it.  the verifier finds the argument count there
+  for (int f=0; f<sFuncs; ++f) {
+    int  end  = (f + 1 < sFuncs) ? sFuncPos[f + 1] : cCodeLen;
+    int  last = -1;
+    bool live = false;
+    for (int i=sFuncPos[f]; i<end; i+=insSize(cCode[i])) {
+      if (cCode[i] == INS_RETURN) {
+        last = cDead[i] ? i : -2;
+      }
+      if (last == -2) {
+        break;
+      }
+      live |= !cDead[i] && cCode[i] != INS_LINE;
+    }
+    if (last >= 0 && live) {
+      cDead[last] = false;
+    }
+  }
+
+  // a line marker without any code left before the next one goes too
+  for (int i=0; i<cCodeLen; i+=insSize(cCode[i])) {
+    if (cCode[i] != INS_LINE) {
+      continue;
+    }
+    bool live = false;
+    for (int j=i + 2; j<cCodeLen && cCode[j] != INS_LINE && !live;
+         j+=insSize(cCode[j])) {
+      live = !cDead[j];
+    }
+    cDead[i] = !live;
+  }
+
+  // close up the code
+  int to = 0;
+  for (int i=0; i<cCodeLen; ) {
+    int size = insSize(cCode[i]);
+    for (int k=0; k<size; ++k) {
+      cMoved[i + k] = cDead[i] ? to : to + k;
+      if (!cDead[i]) {
+        cCode[to + k] = cCode[i + k];
+      }
+    }
+    to += cDead[i] ? 0 : size;
+    i  += size;
+  }
+  cMoved[cCodeLen] = to;
+  cCodeLen = to;
+
+  // and move what points into it
+  for (int i=0; i<cCodeLen; i+=insSize(cCode[i])) {
+    int ins = cCode[i];
+    if (cIsJump(ins) || ins == INS_CALL) {
+      cCode[i + 1] = cMoved[cCode[i + 1]];
+    }
+    if (ins == INS_TAILCALL) {
+      int opr = cCode[i + 1];
+      cCode[i + 1] = TAIL_OPR(cMoved[TAIL_TO(opr)], TAIL_ARGS(opr),
+                              TAIL_DROP(opr));
+    }
+  }
+  for (int f=0; f<sFuncs; ++f) {
+    sFuncPos[f] = cMoved[sFuncPos[f]];
+  }
+}
+
 int main(int argc, char **args) {
 
   // idenfity reserved symbols
@@ -1130,12 +2383,24 @@ int main(int argc, char **args) {
   // line counting starts at 1
   lLine = 1;
 
-  if (argc <= 1) {
+  // usage: parse [-O0] file
+  char *path     = NULL;
+  bool  optimize = true;
+  for (int i=1; i<argc; ++i) {
+    if (strMatch(args[i], "-O0")) {
+      optimize = false;
+    }
+    else {
+      path = args[i];
+    }
+  }
+
+  if (!path) {
     fatal("%u: error: argument expected", lLine);
   }
 
   // open input file for reading
-  inFile = fopen(args[1], "r");
+  inFile = fopen(path, "r");
   if (!inFile) {
     return 1;
   }
@@ -1159,6 +2424,11 @@ int main(int argc, char **args) {
   int idMain = sFuncFind(sMain);
   cPatch(jmpMain, sFuncPos[idMain]);
 
+  // tidy the code, -O0 keeps it as emitted
+  if (optimize) {
+    cOptimize();
+  }
+
   // patch in the string table
   cPatch(strtabOpr, cPos());
   for (int i=0; i<cStrTabLen; ++i) {
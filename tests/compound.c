@@ -0,0 +1,41 @@
+// compound assignment on locals, arguments and globals
+
+int g;
+
+int f(int x) {
+    int y;
+    y = 7;
+    x += 3;
+    x -= y;
+    x *= 5;
+    y /= 2;
+    x %= 11;
+    y |= 8;
+    y &= 10;
+    g += x;
+    g -= -4;
+    return x * 100 + y;
+}
+
+int h() {
+    g = g + 10;
+    return 0;
+}
+
+int main() {
+    int a, b;
+    g = 1;
+    a = f(6);
+    b = a += 2;
+    b -= 1000;
+    printf("%d %d %d\n", a, b, g);
+    // unused post increments followed by other statements
+    a++;
+    h();
+    b++;
+    ++b;
+    g++;
+    --g;
+    printf("%d %d %d\n", a, b, g);
+    return g;
+}
@@ -0,0 +1,30 @@
+// compound assignment and increments on array elements
+
+int glob[4];
+
+int main() {
+    int loc[4];
+    int i, s;
+    for (i = 0; i < 4; i += 1) {
+        loc[i] = i;
+        glob[i] = 10;
+    }
+    for (i = 0; i < 4; ++i) {
+        glob[i] += loc[i] * 2;
+        loc[i] -= 1;
+        glob[3 - i] *= 2;
+    }
+    ++glob[0];
+    loc[1]++;
+    --loc[2];
+    glob[2]--;
+    s = 0;
+    i = 4;
+    while (i--) {
+        s += glob[i] - loc[i];
+        printf("%d %d\n", glob[i], loc[i]);
+    }
+    s -= i++;
+    s -= ++i;
+    return s;
+}
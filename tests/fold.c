@@ -0,0 +1,37 @@
+int main() {
+    int a = 3 * 4 + 1;
+    int b = -5;
+    int c = 1 << 4 | 2;
+    int i;
+
+    // folded where possible, even the constant conditions
+    if (0) {
+        printf("never\n");
+    }
+    if (!0) {
+        printf("%d %d %d\n", a, b, c);
+    }
+    printf("%d %d %d\n", 2147483647 + 1, -7 / 2, -7 % 2);
+    printf("%d %d %d\n", 1 < 2, 3 == 4, (6 ^ 3) >= 5);
+
+    i = 0;
+    while (1) {
+        if (++i == a) {
+            break;
+        }
+    }
+    do {
+        i = i + b;
+    } while (0);
+
+    // case labels may be constant expressions
+    switch (i) {
+    case 2 * 4:
+        printf("eight\n");
+        break;
+    case -1 - 1:
+        printf("minus two\n");
+        break;
+    }
+    return i - 8;
+}
@@ -0,0 +1,77 @@
+int main() {
+    int i;
+    int j;
+    int n;
+
+    // continue and break in a loop with a compound condition
+    n = 0;
+    for (i = 0; i < 20 && n < 40; i++) {
+        if (i == 3) continue;
+        if (i == 15) break;
+        n = n + i;
+    }
+    putchar('0' + n % 10);
+    putchar('0' + i % 10);
+
+    // condition false on entry
+    for (i = 5; i < 5; i++) {
+        putchar('x');
+    }
+    while (i < 5) {
+        putchar('x');
+    }
+
+    // nested loops with conditional expressions in the condition
+    j = 0;
+    while ((j < 3 ? j : 0) || j == 0) {
+        for (i = j; i ? i > 0 : 0; i--) {
+            putchar('a' + i);
+        }
+        j++;
+    }
+
+    // loop without a condition
+    for (i = 0;; ) {
+        if (++i > 4) break;
+        putchar('A' + i);
+    }
+    putchar('\n');
+
+    // nested mixed condition tested at the bottom
+    i = 0;
+    j = 0;
+    while (i < 5 && (i != 2 || j > 0)) {
+        j++;
+        i++;
+    }
+    n = n + i * 10 + j;
+
+    // a condition and an increment too long to be emitted twice
+    j = 1;
+    i = 0;
+    while (i < j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j) {
+        i = i + 7;
+    }
+    for (j = 0; j < 3; i = i - (j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j +
+           j + j + j + j + j + j + j + j + j + j)) {
+        j++;
+    }
+    return i + n;
+}
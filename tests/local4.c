@@ -0,0 +1,21 @@
+int sum(int n) {
+    int s = 0;
+    while (n > 0) {
+        // a local declared in the loop must not grow the stack
+        int x = n % 7;
+        s = (s + x) % 10007;
+        n = n - 1;
+    }
+    return s;
+}
+
+int main() {
+    int i;
+    for (i = 0; i < 2; i = i + 1) {
+        int a[3];
+        a[i] = i + 1;
+        printf("%d\n", a[i]);
+    }
+    printf("%d\n", sum(2000000));
+    return 0;
+}
@@ -0,0 +1,34 @@
+int main() {
+    int a = 1;
+    {
+        int b[4];
+        b[3] = 4;
+        {
+            int c = 3;
+            a = a + b[3] + c;
+        }
+        int d = 5;
+        a = a * d;
+    }
+    {
+        // siblings share the slots of the block above
+        int e = 7;
+        int f[2];
+        f[1] = e + a;
+        a = f[1];
+    }
+    {
+        // uninitialized locals in reused slots still start at zero
+        int g;
+        int h[3];
+        a = a + g + h[0] + h[2];
+        g = 9;
+        h[2] = 8;
+    }
+    {
+        int k[4];
+        a = a + k[0] + k[3];
+    }
+    printf("%d\n", a);
+    return a - 47;
+}
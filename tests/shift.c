@@ -0,0 +1,32 @@
+int hash(char *s) {
+  int h;
+  h = 5381;
+  while (*s) {
+    h = ((h << 5) + h) ^ *s;
+    h &= 16777215;
+    s++;
+  }
+  return h;
+}
+
+int main() {
+  int x;
+  int i;
+  int n;
+  x = 2463534;
+  for (i = 0; i < 5; i++) {
+    x ^= x << 13 & 2147483647;
+    x ^= x >> 17;
+    x ^= x << 5 & 2147483647;
+    printf("%d\n", x);
+  }
+  printf("%d %d\n", hash("hello"), hash("shift and xor"));
+  printf("%d %d %d\n", 1 << 4 + 1, 256 >> 2 >> 1, -64 >> 3);
+  printf("%d %d %d\n", 6 ^ 3 & 5, 6 ^ 3 | 8, 3 < 1 << 2);
+  n = 1;
+  n <<= 10;
+  n >>= 3;
+  n ^= 255;
+  printf("%d %d\n", n, 100 >> 2 == 25);
+  return 0;
+}
@@ -0,0 +1,59 @@
+int calls;
+
+int t(int v) {
+  calls = calls + 1;
+  return v;
+}
+
+int main() {
+  int i;
+  int a;
+  int b;
+  a = 0;
+  b = 0;
+  printf("%d %d %d %d\n", 0 && t(1), 1 && t(2), 0 || t(0), 3 || t(1));
+  printf("calls %d\n", calls);
+  i = 0;
+  while (i < 10 && t(i) != 7) {
+    i++;
+  }
+  printf("%d calls %d\n", i, calls);
+  for (i = 0; i < 5 || (i < 9 && t(i) != 8); i++) {
+    if ((i & 1) && (t(i) || a)) {
+      a++;
+    }
+    else if (i == 2 || t(i) == 3 || !(i < 6 && i > 4)) {
+      b++;
+    }
+  }
+  printf("%d %d %d calls %d\n", i, a, b, calls);
+  i = 0;
+  do {
+    i++;
+  } while (i < 3 || i < 6 && i != 5);
+  a = (i > 2 && i < 9) + (i < 2 || i > 9) * 2 + (i && 0 || 1) * 4;
+  printf("%d %d\n", i, a);
+  // nested mixed chains as conditions
+  a = 0;
+  for (i = 0; i < 8; i++) {
+    if (i >= 5 || (i != 2 && i < 1)) {
+      a++;
+    }
+    if ((i < 3 || t(i) > 6) && (i != 1 || (a && t(i)))) {
+      a = a + 10;
+    }
+  }
+  b = 0;
+  i = 0;
+  while (i < 5 && (i != 2 || b > 0)) {
+    b++;
+    i++;
+  }
+  printf("%d %d %d calls %d\n", a, b, i, calls);
+  i = 0;
+  do {
+    i++;
+  } while (i < 9 && (i == 3 || (i != 6 && t(i) < 7)));
+  printf("%d calls %d\n", i, calls);
+  return 0;
+}
@@ -0,0 +1,92 @@
+int classify(int c) {
+  switch (c) {
+  case ' ':
+  case '\t':
+  case '\n':
+    return 0;
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    return 1;
+  case '+':
+  case '-':
+    return 2;
+  default:
+    return 3;
+  }
+}
+
+int sparse(int v) {
+  int r;
+  r = 0;
+  switch (v) {
+  case -1000: r = 1; break;
+  case -3:    r = 2; break;
+  case 7:     r = 3;
+  case 8:     r = r + 4; break;
+  case 100:   r = 5; break;
+  case 5000:  r = 6; break;
+  case 123456: r = 7; break;
+  }
+  return r;
+}
+
+int run(int *prog) {
+  int pc;
+  int acc;
+  pc = 0;
+  acc = 0;
+  for (;;) {
+    switch (prog[pc]) {
+    case 0: return acc;
+    case 1: acc = acc + prog[pc + 1]; pc += 2; continue;
+    case 2: acc = acc * prog[pc + 1]; pc += 2; continue;
+    case 3:
+      switch (prog[pc + 1]) {
+      case 0: acc = -acc; break;
+      default: acc = acc / 2;
+      }
+      pc += 2;
+      break;
+    case 4: printf("acc %d\n", acc); pc++; break;
+    default: printf("bad op %d\n", prog[pc]); return -1;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  int i;
+  int n;
+  int prog[16];
+  char *s;
+  s = "a 12 + -9\tz";
+  n = 0;
+  for (i = 0; s[i]; i++) {
+    n = n * 4 + classify(s[i]);
+    n &= 65535;
+  }
+  printf("%d\n", n);
+  for (i = -1001; i < 200000; i++) {
+    if (sparse(i)) {
+      printf("%d -> %d\n", i, sparse(i));
+    }
+  }
+  prog[0] = 1; prog[1] = 5;
+  prog[2] = 2; prog[3] = 7;
+  prog[4] = 4;
+  prog[5] = 3; prog[6] = 0;
+  prog[7] = 4;
+  prog[8] = 3; prog[9] = 1;
+  prog[10] = 4;
+  prog[11] = 9;
+  printf("%d\n", run(prog));
+  prog[11] = 0;
+  printf("%d\n", run(prog));
+  switch (n) {
+  }
+  switch (n) {
+  default:
+    printf("only default\n");
+  }
+  return 0;
+}
@@ -0,0 +1,46 @@
+int sum(int n, int acc) {
+  if (n == 0) {
+    return acc;
+  }
+  return sum(n - 1, (acc + n) % 9973);
+}
+
+int parity(int n, int odd) {
+  if (n == 0) {
+    return odd;
+  }
+  return parity(n - 1, !odd);
+}
+
+int gcd3(int a, int b, int c) {
+  return c ? gcd3(b, c, a % c) : b;
+}
+
+int gcd(int a, int b) {
+  if (b == 0) {
+    return a;
+  }
+  return gcd3(a, b, a % b);
+}
+
+int count(int *p, int n) {
+  if (n == 0) {
+    return *p;
+  }
+  *p = *p + 1;
+  return count(p, n - 1);
+}
+
+int local(int n) {
+  int x;
+  x = n;
+  return count(&x, n);
+}
+
+int main() {
+  printf("%d\n", sum(10000, 0));
+  printf("%d %d\n", parity(20001, 0), parity(12, 0));
+  printf("%d %d\n", gcd(1071, 462), gcd(17, 5));
+  printf("%d\n", local(10));
+  return sum(10, 0) - 55;
+}
@@ -0,0 +1,63 @@
+int calls;
+
+int f(int v) {
+  calls++;
+  return v;
+}
+
+int max(int a, int b) {
+  return a > b ? a : b;
+}
+
+int clamp(int v, int lo, int hi) {
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+int main() {
+  int i;
+  int a;
+  int b;
+  int *p;
+  int arr[4];
+  p = 0;
+  arr[0] = 3;
+  arr[1] = 9;
+  a = 0;
+  for (i = -3; i < 15; i++) {
+    a = a * 3 + clamp(i, 0, 10) + max(i, 5);
+    a &= 65535;
+  }
+  printf("%d\n", a);
+  b = 1 ? 2 : 3;
+  a = 0 ? 4 : 1 ? 5 : 6;
+  printf("%d %d\n", a, b);
+  a = p ? *p : -1;
+  p = arr;
+  b = p ? p[1] : -1;
+  printf("%d %d\n", a, b);
+  a = arr[0] == 3 ? f(10) : f(20);
+  b = arr[0] != 3 ? f(30) : f(40);
+  printf("%d %d calls %d\n", a, b, calls);
+  a = (arr[0] && arr[1]) ? 7 : 8;
+  b = (arr[2] = 0) || arr[0] > 5 ? 1 : 2;
+  printf("%d %d\n", a, b);
+  i = 5;
+  a = i++ ? i : 0;
+  b = i > 3 ? i * 2 + 1 : i - 1;
+  printf("%d %d %d\n", a, b, i ? i < 6 ? 100 : 200 : 300);
+  a = 1;
+  b = 2;
+  a = a < b ? (b = 10) : (a = 20);
+  printf("%d %d\n", a, b);
+  // a false arm ending in || or && used as a condition
+  for (i = 0; i < 4; i++) {
+    if (i & 1 ? i > 2 : (i || b > 5)) {
+      putchar('a' + i);
+    }
+    if (i < 2 ? i : (b && i > 2)) {
+      putchar('A' + i);
+    }
+  }
+  putchar('\n');
+  return 0;
+}
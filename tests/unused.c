@@ -0,0 +1,36 @@
+int unused(int n) {
+    return n * 2;
+}
+
+int unused2(int n) {
+    while (1) {
+        n = n + 1;
+    }
+    return n;
+}
+
+int helper(int n) {
+    return unused2(n) + 1;
+}
+
+int used(int n) {
+    if (n > 3) {
+        return n;
+    }
+    else {
+        return -n;
+    }
+    printf("never\n");
+    return 0;
+}
+
+int main() {
+    int i;
+    for (i = 0; i < 6; i = i + 1) {
+        printf("%d ", used(i));
+        continue;
+        printf("never\n");
+    }
+    printf("\n");
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -61,56 +62,221 @@ int contains(symbol_t find, symbol_t *arr, int count) {
   return -1;
 }
 
-#define DASM0(INS, NAME) \
-  case INS: printf("%2u  %-6s", loc, NAME); return 1;
+// every instruction with its mnemonic
+#define INSTRUCTIONS(X)           \
+  X(INS_DEREF,  "DEREF")          \
+  X(INS_CALL,   "CALL")           \
+  X(INS_CONST,  "CONST")          \
+  X(INS_GETAG,  "GETAG")          \
+  X(INS_GETAL,  "GETAL")          \
+  X(INS_GETAA,  "GETAA")          \
+  X(INS_LOADL,  "LOADL")          \
+  X(INS_STOREL, "STOREL")         \
+  X(INS_LOADA,  "LOADA")          \
+  X(INS_STOREA, "STOREA")         \
+  X(INS_LOADG,  "LOADG")          \
+  X(INS_STOREG, "STOREG")         \
+  X(INS_ALLOC,  "ALLOC")          \
+  X(INS_ENTER,  "ENTER")          \
+  X(TOK_ASSIGN, "ASSIGN")         \
+  X(TOK_ADD,    "ADD")            \
+  X(TOK_SUB,    "SUB")            \
+  X(TOK_MUL,    "MUL")            \
+  X(TOK_DIV,    "DIV")            \
+  X(TOK_EQU,    "EQU")            \
+  X(TOK_NEQU,   "NEQU")           \
+  X(TOK_LOGOR,  "LOGOR")          \
+  X(TOK_LOGAND, "LOGAND")         \
+  X(TOK_BITOR,  "BITOR")          \
+  X(TOK_BITAND, "BITAND")         \
+  X(TOK_BITXOR, "BITXOR")         \
+  X(TOK_SHL,    "SHL")            \
+  X(TOK_SHR,    "SHR")            \
+  X(TOK_MOD,    "MOD")            \
+  X(TOK_LT,     "LT")             \
+  X(TOK_GT,     "GT")             \
+  X(TOK_LTEQU,  "LTEQU")          \
+  X(TOK_GTEQU,  "GTEQU")          \
+  X(INS_RETURN, "RETURN")         \
+  X(INS_JMP,    "JMP")            \
+  X(INS_JZ,     "JZ")             \
+  X(INS_JNZ,    "JNZ")            \
+  X(INS_JLT,    "JLT")            \
+  X(INS_JGE,    "JGE")            \
+  X(INS_JEQ,    "JEQ")            \
+  X(INS_JNE,    "JNE")            \
+  X(INS_JGT,    "JGT")            \
+  X(INS_JLE,    "JLE")            \
+  X(INS_SWITCH, "SWITCH")         \
+  X(INS_TAILCALL, "TAILCALL")     \
+  X(INS_INCL,   "INCL")           \
+  X(INS_INCA,   "INCA")           \
+  X(INS_INCG,   "INCG")           \
+  X(INS_ADDASSIGN, "ADDASSIGN")   \
+  X(INS_INDEX,  "INDEX")          \
+  X(INS_STOREX, "STOREX")         \
+  X(INS_SELECT, "SELECT")         \
+  X(INS_DROP,   "DROP")           \
+  X(INS_SCALL,  "SCALL")          \
+  X(INS_NEG,    "NEG")            \
+  X(INS_DUP,    "DUP")            \
+  X(INS_SWAP,   "SWAP")           \
+  X(INS_STRTAB, "STRTAB")         \
+  X(INS_STR,    "STR")            \
+  X(TOK_LOGNOT, "LOGNOT")         \
+  X(INS_LINE,   "; --- line")
 
-#define DASM1(INS, NAME) \
-  case INS: printf("%2u  %-6s %u", loc, NAME, opr); return 2;
+// return the mnemonic of an instruction or NULL if it is unknown
+char *insName(int ins) {
+#define X(INS, NAME) case INS: return NAME;
+  switch (ins) {
+  INSTRUCTIONS(X)
+  default:
+    return NULL;
+  }
+#undef X
+}
 
-int dasm(int *cCode, int loc) {
-  int ins = cCode[0];
-  int opr = cCode[1];
+// return the name of the constant for an instruction or NULL if unknown
+char *insSymbol(int ins) {
+#define X(INS, NAME) case INS: return #INS;
   switch (ins) {
-  DASM0(INS_DEREF,  "DEREF");
-  DASM1(INS_CALL,   "CALL");
-  DASM1(INS_CONST,  "CONST");
-  DASM1(INS_GETAG,  "GETAG");
-  DASM1(INS_GETAL,  "GETAL");
-  DASM1(INS_GETAA,  "GETAA");
-  DASM1(INS_ALLOC,  "ALLOC");
-  DASM0(TOK_ASSIGN, "ASSIGN");
-  DASM0(TOK_ADD,    "ADD");
-  DASM0(TOK_SUB,    "SUB");
-  DASM0(TOK_MUL,    "MUL");
-  DASM0(TOK_DIV,    "DIV");
-  DASM0(TOK_EQU,    "EQU");
-  DASM0(TOK_NEQU,   "NEQU");
-  DASM0(TOK_LOGOR,  "LOGOR");
-  DASM0(TOK_LOGAND, "LOGAND");
-  DASM0(TOK_BITOR,  "BITOR");
-  DASM0(TOK_BITAND, "BITAND");
-  DASM0(TOK_MOD,    "MOD");
-  DASM0(TOK_LT,     "LT");
-  DASM0(TOK_GT,     "GT");
-  DASM0(TOK_LTEQU,  "LTEQU");
-  DASM0(TOK_GTEQU,  "GTEQU");
-  DASM1(INS_RETURN, "RETURN");
-  DASM1(INS_JMP,    "JMP");
-  DASM1(INS_JZ,     "JZ");
-  DASM1(INS_JNZ,    "JNZ");
-  DASM0(INS_DROP,   "DROP");
-  DASM1(INS_SCALL,  "SCALL");
-  DASM0(INS_NEG,    "NEG");
-  DASM0(INS_DUP,    "DUP");
-  DASM0(INS_SWAP,   "SWAP");
-  DASM1(INS_STRTAB, "STRTAB");
-  DASM1(INS_STR,    "STR");
-  DASM0(TOK_LOGNOT, "LOGNOT");
-  DASM1(INS_LINE,   "; --- line");
+  INSTRUCTIONS(X)
   default:
+    return NULL;
+  }
+#undef X
+}
+
+int dasm(int *cCode, int loc) {
+  int ins = cCode[0];
+  char *name = insName(ins);
+  if (!name) {
     printf("%2u  %u", loc, ins);
     return 1;
   }
+  if (insSize(ins) == 1) {
+    printf("%2u  %-6s", loc, name);
+    return 1;
+  }
+  switch (ins) {
+  case INS_INCL:
+  case INS_INCA:
+  case INS_INCG:
+    printf("%2u  %-6s %u, %d", loc, name, INC_SLOT(cCode[1]), INC_BY(cCode[1]));
+    return 2;
+  case INS_TAILCALL:
+    printf("%2u  %-6s %u, %u, %u", loc, name, TAIL_TO(cCode[1]),
+           TAIL_ARGS(cCode[1]), TAIL_DROP(cCode[1]));
+    return 2;
+  }
+  printf("%2u  %-6s %u", loc, name, cCode[1]);
+  return 2;
+}
+
+// return the size of an instruction in words or 0 if it is unknown
+int insSize(int ins) {
+  switch (ins) {
+  case INS_DEREF:
+  case INS_DROP:
+  case INS_NEG:
+  case INS_DUP:
+  case INS_SWAP:
+  case TOK_LOGNOT:
+  case TOK_ASSIGN:
+  case TOK_ADD:
+  case TOK_SUB:
+  case TOK_MUL:
+  case TOK_DIV:
+  case TOK_MOD:
+  case TOK_LOGOR:
+  case TOK_LOGAND:
+  case TOK_BITOR:
+  case TOK_BITAND:
+  case TOK_BITXOR:
+  case TOK_SHL:
+  case TOK_SHR:
+  case TOK_LT:
+  case TOK_GT:
+  case TOK_LTEQU:
+  case TOK_GTEQU:
+  case TOK_EQU:
+  case TOK_NEQU:
+  case INS_ADDASSIGN:
+  case INS_INDEX:
+  case INS_STOREX:
+  case INS_SELECT:
+    return 1;
+  case INS_CONST:
+  case INS_CALL:
+  case INS_GETAG:
+  case INS_GETAL:
+  case INS_GETAA:
+  case INS_LOADL:
+  case INS_STOREL:
+  case INS_LOADA:
+  case INS_STOREA:
+  case INS_LOADG:
+  case INS_STOREG:
+  case INS_ALLOC:
+  case INS_ENTER:
+  case INS_RETURN:
+  case INS_JMP:
+  case INS_JZ:
+  case INS_JNZ:
+  case INS_JLT:
+  case INS_JGE:
+  case INS_JEQ:
+  case INS_JNE:
+  case INS_JGT:
+  case INS_JLE:
+  case INS_SWITCH:
+  case INS_TAILCALL:
+  case INS_INCL:
+  case INS_INCA:
+  case INS_INCG:
+  case INS_SCALL:
+  case INS_STRTAB:
+  case INS_STR:
+  case INS_LINE:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+// apply the binary operator 'ins' to two constants as exec does, in 'res'.
+// false if it would fault at run time so it must be left to happen there
+bool insFold(int ins, int lhs, int rhs, int *res) {
+  unsigned a = lhs, b = rhs;
+  switch (ins) {
+  case TOK_ADD:     *res = (int)(a + b); break;
+  case TOK_SUB:     *res = (int)(a - b); break;
+  case TOK_MUL:     *res = (int)(a * b); break;
+  case TOK_EQU:     *res = lhs == rhs; break;
+  case TOK_NEQU:    *res = lhs != rhs; break;
+  case TOK_LOGOR:   *res = lhs || rhs; break;
+  case TOK_LOGAND:  *res = lhs && rhs; break;
+  case TOK_BITOR:   *res = lhs |  rhs; break;
+  case TOK_BITAND:  *res = lhs &  rhs; break;
+  case TOK_BITXOR:  *res = lhs ^  rhs; break;
+  case TOK_SHL:     *res = (int)(a << (rhs & 31)); break;
+  case TOK_SHR:     *res = lhs >> (rhs & 31); break;
+  case TOK_LT:      *res = lhs <  rhs; break;
+  case TOK_GT:      *res = lhs >  rhs; break;
+  case TOK_LTEQU:   *res = lhs <= rhs; break;
+  case TOK_GTEQU:   *res = lhs >= rhs; break;
+  case TOK_DIV:
+  case TOK_MOD:
+    if (rhs == 0 || (lhs == INT_MIN && rhs == -1)) {
+      return false;
+    }
+    *res = (ins == TOK_DIV) ? lhs / rhs : lhs % rhs;
+    break;
+  default:
+    return false;
+  }
+  return true;
 }
 
 char *tokName(token_t tok) {
@@ -127,6 +293,9 @@ char *tokName(token_t tok) {
   case TOK_BITOR:   return "|";
   case TOK_LOGAND:  return "&&";
   case TOK_BITAND:  return "&";
+  case TOK_BITXOR:  return "^";
+  case TOK_SHL:     return "<<";
+  case TOK_SHR:     return ">>";
   case TOK_SEMI:    return ";";
   case TOK_LPAREN:  return "(";
   case TOK_RPAREN:  return ")";
@@ -147,6 +316,18 @@ char *tokName(token_t tok) {
   case TOK_SYMBOL:  return "symbol";
   case TOK_INTLIT:  return "integer literal";
   case TOK_STRLIT:  return "string literal";
+  case TOK_COLON:   return ":";
+  case TOK_QUESTION: return "?";
+  case TOK_ADDASSIGN: return "+=";
+  case TOK_SUBASSIGN: return "-=";
+  case TOK_MULASSIGN: return "*=";
+  case TOK_DIVASSIGN: return "/=";
+  case TOK_MODASSIGN: return "%=";
+  case TOK_ORASSIGN:  return "|=";
+  case TOK_ANDASSIGN: return "&=";
+  case TOK_XORASSIGN: return "^=";
+  case TOK_SHLASSIGN: return "<<=";
+  case TOK_SHRASSIGN: return ">>=";
   case TOK_IF:      return "if";
   case TOK_INT:     return "int";
   case TOK_RETURN:  return "return";
@@ -156,6 +337,9 @@ char *tokName(token_t tok) {
   case TOK_WHILE:   return "while";
   case TOK_DO:      return "do";
   case TOK_FOR:     return "for";
+  case TOK_SWITCH:  return "switch";
+  case TOK_CASE:    return "case";
+  case TOK_DEFAULT: return "default";
   default:          return "unknown";
   }
 }
@@ -0,0 +1,845 @@
+// interpreter loop template
+//
+// exec.c includes this file once for each interpreter variant it wants to
+// generate.  the following must be defined before including it:
+//
+//   LOOP_NAME   name of the generated function
+//   LOOP_TOS    when 1 the top of stack is cached in the local 'tos'
+//   LOOP_CHECK  when 0 the per instruction stack checks are left out, which
+//               is only safe for programs which passed vVerify
+//   LOOP_HOT    when 1 backward jumps are counted in vHot and the loop returns
+//               with the VM state saved once a loop header gets hot
+//   LOOP_CALLS  when 1 calls are counted in vHot as well and the loop returns
+//               at the entry of a function once it gets hot
+//   LOOP_TRACE  when 1 each instruction is printed by vTraceIns before it runs
+//   LOOP_PROFILE when 1 each instruction executed is counted in vProfile
+//   LOOP_SUPER  when 1 the superinstructions marked by vFuse are used, which
+//               is the default unless tracing or profiling
+//
+// the last five are optional and default to off, so a variant only pays for
+// the features it was generated with.
+//
+// the loop runs over the decoded instruction stream built by vDecode.  on
+// entry the handler address of each decoded instruction is filled in from
+// 'labels' and every handler finishes by jumping straight to the handler of
+// the next instruction, so the hot path does no decoding or range checking of
+// the program counter.  the VM registers live in locals and are only written
+// back to the globals around calls into the helpers.
+//
+// when the top of stack is cached the cells [0, sp-1) are always valid in
+// vStack and cell sp-1 is held in 'tos'.  every address a program can form
+// which is legal to dereference lies below the top cell so the cache never
+// needs to be flushed for memory accesses, only for helpers which read the
+// stack directly.
+
+#ifndef LOOP_HOT
+#define LOOP_HOT     0
+#endif
+#ifndef LOOP_CALLS
+#define LOOP_CALLS   0
+#endif
+#ifndef LOOP_TRACE
+#define LOOP_TRACE   0
+#endif
+#ifndef LOOP_PROFILE
+#define LOOP_PROFILE 0
+#endif
+#ifndef LOOP_SUPER
+#define LOOP_SUPER   (!LOOP_TRACE && !LOOP_PROFILE)
+#endif
+
+void LOOP_NAME() {
+
+  static void *labels[256] = {
+    [0 ... 255]  = &&ins_bad,
+    [INS_DEREF]  = &&ins_deref,
+    [INS_DROP]   = &&ins_drop,
+    [TOK_LOGNOT] = &&ins_lognot,
+    [TOK_ASSIGN] = &&ins_assign,
+    [INS_ADDASSIGN] = &&ins_addassign,
+    [INS_INDEX]  = &&ins_index,
+    [INS_STOREX] = &&ins_storex,
+    [INS_SELECT] = &&ins_select,
+    [TOK_ADD]    = &&ins_add,
+    [TOK_SUB]    = &&ins_sub,
+    [TOK_MUL]    = &&ins_mul,
+    [TOK_DIV]    = &&ins_div,
+    [TOK_MOD]    = &&ins_mod,
+    [TOK_LOGOR]  = &&ins_logor,
+    [TOK_LOGAND] = &&ins_logand,
+    [TOK_BITOR]  = &&ins_bitor,
+    [TOK_BITAND] = &&ins_bitand,
+    [TOK_BITXOR] = &&ins_bitxor,
+    [TOK_SHL]    = &&ins_shl,
+    [TOK_SHR]    = &&ins_shr,
+    [TOK_LT]     = &&ins_lt,
+    [TOK_GT]     = &&ins_gt,
+    [TOK_LTEQU]  = &&ins_ltequ,
+    [TOK_GTEQU]  = &&ins_gtequ,
+    [TOK_EQU]    = &&ins_equ,
+    [TOK_NEQU]   = &&ins_nequ,
+    [INS_NEG]    = &&ins_neg,
+    [INS_DUP]    = &&ins_dup,
+    [INS_SWAP]   = &&ins_swap,
+    [INS_STRTAB] = &&ins_strtab,
+    [INS_STR]    = &&ins_str,
+    [INS_CONST]  = &&ins_const,
+    [INS_CALL]   = &&ins_call,
+    [INS_TAILCALL] = &&ins_tailcall,
+    [INS_GETAG]  = &&ins_getag,
+    [INS_GETAL]  = &&ins_getal,
+    [INS_GETAA]  = &&ins_getaa,
+    [INS_LOADL]  = &&ins_loadl,
+    [INS_STOREL] = &&ins_storel,
+    [INS_LOADA]  = &&ins_loada,
+    [INS_STOREA] = &&ins_storea,
+    [INS_LOADG]  = &&ins_loadg,
+    [INS_STOREG] = &&ins_storeg,
+    [INS_INCL]   = &&ins_incl,
+    [INS_INCA]   = &&ins_inca,
+    [INS_INCG]   = &&ins_incg,
+    [INS_ALLOC]  = &&ins_alloc,
+    [INS_ENTER]  = &&ins_alloc,
+    [INS_RETURN] = &&ins_return,
+    [INS_JMP]    = &&ins_jmp,
+    [INS_JZ]     = &&ins_jz,
+    [INS_JNZ]    = &&ins_jnz,
+    [INS_JLT]    = &&ins_jlt,
+    [INS_JGE]    = &&ins_jge,
+    [INS_JEQ]    = &&ins_jeq,
+    [INS_JNE]    = &&ins_jne,
+    [INS_JGT]    = &&ins_jgt,
+    [INS_JLE]    = &&ins_jle,
+    [INS_SWITCH] = &&ins_switch,
+    [INS_SCALL]  = &&ins_scall,
+    [DEC_BADPC]  = &&ins_badpc,
+  };
+
+#if LOOP_SUPER
+  static void *supers[] = {
+    &&ins_bad,
+#define SUPER2(A, B)    &&super_##A##_##B,
+#define SUPER3(A, B, C) &&super_##A##_##B##_##C,
+#include "vsuper.h"
+#undef SUPER2
+#undef SUPER3
+  };
+#endif
+
+  // point the decoded instructions at our handlers
+  if (vDecLabels != labels) {
+    for (int i=0; i<vDecLen; ++i) {
+      vDec[i].op = labels[vDecIns[i]];
+#if LOOP_SUPER
+      // the instructions after keep their own handlers so execution can
+      // still resume in the middle, eg. after a trace exits
+      if (vSuper[i]) {
+        vDec[i].op = supers[vSuper[i]];
+      }
+#endif
+    }
+    vDecLabels = labels;
+  }
+
+  vdec_t *ip = vDec + vDecAt[vPC];
+  int sp = vStackPtr;
+  int fp = vFP;
+  int pc, opr, lhs, rhs;
+
+#define SAVE() (vPC = ip->pc, vStackPtr = sp, vFP = fp)
+#define LOAD() (sp = vStackPtr, fp = vFP)
+
+#if LOOP_TOS
+  int tos;
+#define T         tos                                    // top cell
+#define SPILL()   (vStack[sp - 1] = tos)                 // write back top
+#define FILL()    (tos = vStack[sp - 1])                 // reload top
+#define GROW(V)   (vStack[sp - 1] = tos, ++sp, tos = (V))
+#define SHRINK()  (--sp, tos = vStack[sp - 1])
+#else
+#define T         vStack[sp - 1]
+#define SPILL()   ((void)0)
+#define FILL()    ((void)0)
+#define GROW(V)   (vStack[sp++] = (V))
+#define SHRINK()  (--sp)
+#endif
+
+// cell below the top, always held in memory
+#define S(N)      vStack[sp - 1 - (N)]
+
+#if LOOP_CHECK
+// check the stack holds at least N cells
+#define NEED(N)                        \
+  if (sp < (N))                        \
+    fatal("error: stack underflow");
+
+// check there is room to push N cells
+#define ROOM(N)                        \
+  if (sp > NMEMORY - (N))              \
+    fatal("error: stack overflow");
+// check a variable address lies below the top N cells
+#define ADDR(A, N, WHY)                \
+  if ((A) < 0 || (A) >= sp - (N))      \
+    fatal(WHY);
+#else
+// the verifier proved these can't fail
+#define NEED(N)
+#define ROOM(N)
+#define ADDR(A, N, WHY)
+#endif
+
+#define OPR()  (opr = ip[-1].opr)
+
+#if LOOP_TRACE
+#define NEXT()                         \
+  do {                                 \
+    SPILL();                           \
+    SAVE();                            \
+    vTraceIns();                       \
+    goto *(ip++)->op;                  \
+  } while (0)
+#elif LOOP_PROFILE
+#define NEXT()                         \
+  do {                                 \
+    ++vProfile[ip - vDec];             \
+    goto *(ip++)->op;                  \
+  } while (0)
+#else
+#define NEXT() goto *(ip++)->op
+#endif
+
+#if LOOP_HOT
+// take a jump to opr, handing hot loop headers back to the caller
+#define JUMP()                                         \
+  if (opr < ip - vDec && ++vHot[opr] >= HOT_LOOP) {    \
+    ip = vDec + opr;                                   \
+    SPILL();                                           \
+    SAVE();                                            \
+    return;                                            \
+  }                                                    \
+  ip = vDec + opr;
+#else
+#define JUMP() ip = vDec + opr;
+#endif
+
+// pop two operands and push the result
+#define BINOP(EXPR)                    \
+  do {                                 \
+    NEED(2);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T;                           \
+    T = (EXPR);                        \
+  } while (0)
+
+// the body of each handler, named after its opcode so vsuper.h can string
+// them together into superinstructions.  the operand of each instruction is
+// read from ip[-1] so a fused handler steps ip between the bodies
+
+  // zero operand instructions
+#define DO_INS_DEREF                   \
+  do {                                 \
+    NEED(1);                           \
+    lhs = T;                           \
+    if (lhs < 0 || lhs >= sp - 1) {    \
+      fatal("error: invalid dereference"); \
+    }                                  \
+    T = vStack[lhs];                   \
+  } while (0)
+
+#define DO_INS_DROP                    \
+  do {                                 \
+    NEED(1);                           \
+    SHRINK();                          \
+  } while (0)
+
+#define DO_TOK_LOGNOT                  \
+  do {                                 \
+    NEED(1);                           \
+    T = !T;                            \
+  } while (0)
+
+#define DO_TOK_ASSIGN                  \
+  do {                                 \
+    NEED(2);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T;                           \
+    if (lhs < 0 || lhs >= sp - 1) {    \
+      fatal("error: invalid lvalue address"); \
+    }                                  \
+    T = vStack[lhs] = rhs;             \
+  } while (0)
+
+#define DO_INS_ADDASSIGN               \
+  do {                                 \
+    NEED(2);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T;                           \
+    if (lhs < 0 || lhs >= sp - 1) {    \
+      fatal("error: invalid lvalue address"); \
+    }                                  \
+    T = vStack[lhs] += rhs;            \
+  } while (0)
+
+#define DO_INS_INDEX                   \
+  do {                                 \
+    NEED(2);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T + rhs;                     \
+    if (lhs < 0 || lhs >= sp - 1) {    \
+      fatal("error: invalid dereference"); \
+    }                                  \
+    T = vStack[lhs];                   \
+  } while (0)
+
+#define DO_INS_STOREX                  \
+  do {                                 \
+    NEED(3);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T;                           \
+    SHRINK();                          \
+    lhs += T;                          \
+    if (lhs < 0 || lhs >= sp - 1) {    \
+      fatal("error: invalid lvalue address"); \
+    }                                  \
+    T = vStack[lhs] = rhs;             \
+  } while (0)
+
+#define DO_INS_SELECT                  \
+  do {                                 \
+    NEED(3);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T;                           \
+    SHRINK();                          \
+    T = T ? lhs : rhs;                 \
+  } while (0)
+
+#define DO_TOK_ADD     BINOP(lhs +  rhs)
+#define DO_TOK_SUB     BINOP(lhs -  rhs)
+#define DO_TOK_MUL     BINOP(lhs *  rhs)
+#define DO_TOK_LOGOR   BINOP(lhs || rhs)
+#define DO_TOK_LOGAND  BINOP(lhs && rhs)
+#define DO_TOK_BITOR   BINOP(lhs |  rhs)
+#define DO_TOK_BITAND  BINOP(lhs &  rhs)
+#define DO_TOK_BITXOR  BINOP(lhs ^  rhs)
+#define DO_TOK_SHL     BINOP((int)((unsigned)lhs << (rhs & 31)))
+#define DO_TOK_SHR     BINOP(lhs >> (rhs & 31))
+#define DO_TOK_LT      BINOP(lhs <  rhs)
+#define DO_TOK_GT      BINOP(lhs >  rhs)
+#define DO_TOK_LTEQU   BINOP(lhs <= rhs)
+#define DO_TOK_GTEQU   BINOP(lhs >= rhs)
+#define DO_TOK_EQU     BINOP(lhs == rhs)
+#define DO_TOK_NEQU    BINOP(lhs != rhs)
+
+#define DO_TOK_DIV                     \
+  do {                                 \
+    NEED(2);                           \
+    if (T == 0) {                      \
+      fatal("error: division by zero"); \
+    }                                  \
+    BINOP(lhs / rhs);                  \
+  } while (0)
+
+#define DO_TOK_MOD                     \
+  do {                                 \
+    NEED(2);                           \
+    if (T == 0) {                      \
+      fatal("error: division by zero"); \
+    }                                  \
+    BINOP(lhs % rhs);                  \
+  } while (0)
+
+#define DO_INS_NEG                     \
+  do {                                 \
+    NEED(1);                           \
+    T = -T;                            \
+  } while (0)
+
+#define DO_INS_DUP                     \
+  do {                                 \
+    ROOM(1);                           \
+    lhs = T;                           \
+    GROW(lhs);                         \
+  } while (0)
+
+#define DO_INS_SWAP                    \
+  do {                                 \
+    NEED(2);                           \
+    rhs = T;                           \
+    T = S(1);                          \
+    S(1) = rhs;                        \
+  } while (0)
+
+  // one operand instructions
+#define DO_INS_STRTAB                  \
+  do {                                 \
+    vST = OPR();                       \
+  } while (0)
+
+#define DO_INS_STR                     \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    GROW(vST + opr);                   \
+  } while (0)
+
+#define DO_INS_CONST                   \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    GROW(opr);                         \
+  } while (0)
+
+#if LOOP_CHECK
+#define CALL_LIMIT()
+#else
+// one check covers everything the callee pushes
+#define CALL_LIMIT()                   \
+  if (sp > vDecLimit[opr])             \
+    fatal("error: stack overflow");
+#endif
+
+#if LOOP_CALLS
+// hand functions back to the caller once they get hot
+#define CALL_HOT()                     \
+  if (++vHot[opr] >= HOT_CALL) {       \
+    SPILL();                           \
+    SAVE();                            \
+    return;                            \
+  }
+#else
+#define CALL_HOT()
+#endif
+
+#define DO_INS_CALL                    \
+  do {                                 \
+    OPR();                             \
+    ROOM(2);                           \
+    CALL_LIMIT();                      \
+    GROW(fp);                          \
+    GROW(ip[-1].pc + 2);               \
+    ip = vDec + opr;                   \
+    fp = sp;                           \
+    CALL_HOT();                        \
+  } while (0)
+
+#if LOOP_CHECK
+#define TAIL_FRAME()                   \
+  if (sp < rhs || lhs < 0)             \
+    fatal("error: invalid tail call");
+#else
+#define TAIL_FRAME()
+#endif
+
+// move the arguments over those of the caller and the saved frame after
+// them, then call as above
+#define DO_INS_TAILCALL                \
+  do {                                 \
+    OPR();                             \
+    SPILL();                           \
+    rhs = TAIL_ARGS(opr);              \
+    lhs = fp - FRAMESIZE - TAIL_DROP(opr); \
+    TAIL_FRAME();                      \
+    pc = vStack[fp - 1];               \
+    fp = vStack[fp - 2];               \
+    for (int k=0; k<rhs; ++k) {        \
+      vStack[lhs + k] = vStack[sp - rhs + k]; \
+    }                                  \
+    sp  = lhs + rhs;                   \
+    opr = TAIL_TO(opr);                \
+    CALL_LIMIT();                      \
+    vStack[sp++] = fp;                 \
+    vStack[sp++] = pc;                 \
+    FILL();                            \
+    ip = vDec + opr;                   \
+    fp = sp;                           \
+    CALL_HOT();                        \
+  } while (0)
+
+#define DO_INS_GETAG                   \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    GROW(vStackBase + opr);            \
+  } while (0)
+
+#define DO_INS_GETAL                   \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    GROW(fp + opr);                    \
+  } while (0)
+
+#define DO_INS_GETAA                   \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    GROW(fp - opr - FRAMESIZE);        \
+  } while (0)
+
+// push the variable at address A
+#define VAR_LOAD(A)                    \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    lhs = (A);                         \
+    ADDR(lhs, 0, "error: invalid dereference"); \
+    GROW(vStack[lhs]);                 \
+  } while (0)
+
+// store the top cell to the variable at address A
+#define VAR_STORE(A)                   \
+  do {                                 \
+    OPR();                             \
+    NEED(1);                           \
+    lhs = (A);                         \
+    ADDR(lhs, 1, "error: invalid lvalue address"); \
+    vStack[lhs] = T;                   \
+  } while (0)
+
+// add the constant in the operand to the variable at address A and push
+// the result
+#define VAR_INC(A)                     \
+  do {                                 \
+    OPR();                             \
+    ROOM(1);                           \
+    lhs = (A);                         \
+    ADDR(lhs, 0, "error: invalid lvalue address"); \
+    GROW(vStack[lhs] += INC_BY(opr));  \
+  } while (0)
+
+#define DO_INS_INCL    VAR_INC(fp + INC_SLOT(opr))
+#define DO_INS_INCA    VAR_INC(fp - INC_SLOT(opr) - FRAMESIZE)
+#define DO_INS_INCG    VAR_INC(vStackBase + INC_SLOT(opr))
+
+// global operands were made absolute by vDecode
+#define DO_INS_LOADL   VAR_LOAD (fp + opr)
+#define DO_INS_STOREL  VAR_STORE(fp + opr)
+#define DO_INS_LOADA   VAR_LOAD (fp - opr - FRAMESIZE)
+#define DO_INS_STOREA  VAR_STORE(fp - opr - FRAMESIZE)
+#define DO_INS_LOADG   VAR_LOAD (opr)
+#define DO_INS_STOREG  VAR_STORE(opr)
+
+#define DO_INS_ALLOC                   \
+  do {                                 \
+    OPR();                             \
+    ROOM(opr);                         \
+    if (opr > 0) {                     \
+      SPILL();                         \
+      memset(vStack + sp, 0, opr * 4); \
+      sp += opr;                       \
+      FILL();                          \
+    }                                  \
+  } while (0)
+
+#if LOOP_CHECK
+#define RETURN_FRAME()
+#else
+// the frame lives in memory the program can write to, so make sure we
+// landed somewhere with the stack depth and room the verifier assumed
+#define RETURN_FRAME()                                   \
+  opr = ip - vDec;                                       \
+  if (vDecDepth[opr] != sp - fp ||                       \
+      fp - FRAMESIZE > vDecLimit[vDecFunc[opr]]) {       \
+    fatal("error: corrupt stack frame");                 \
+  }
+#endif
+
+#define DO_INS_RETURN                  \
+  do {                                 \
+    OPR();                             \
+    NEED(1);                           \
+    SPILL();                           \
+    rhs = T;                           \
+    sp = fp;                           \
+    NEED(1);                           \
+    pc = vStack[--sp];                 \
+    NEED(1);                           \
+    fp = vStack[--sp];                 \
+    sp -= opr;                         \
+    ROOM(1);                           \
+    ++sp;                              \
+    T = rhs;                           \
+    if (fp <= vStackBase) {            \
+      exit(rhs);                       \
+    }                                  \
+    if ((unsigned)pc >= (unsigned)vCodeEnd || vDecAt[pc] < 0) { \
+      fatal("error: invalid vPC 0x%08x", pc); \
+    }                                  \
+    ip = vDec + vDecAt[pc];            \
+    RETURN_FRAME();                    \
+  } while (0)
+
+#define DO_INS_JMP                     \
+  do {                                 \
+    OPR();                             \
+    JUMP();                            \
+  } while (0)
+
+#define DO_INS_JZ                      \
+  do {                                 \
+    OPR();                             \
+    NEED(1);                           \
+    lhs = T;                           \
+    SHRINK();                          \
+    if (lhs == 0) {                    \
+      JUMP();                          \
+    }                                  \
+  } while (0)
+
+#define DO_INS_JNZ                     \
+  do {                                 \
+    OPR();                             \
+    NEED(1);                           \
+    lhs = T;                           \
+    SHRINK();                          \
+    if (lhs != 0) {                    \
+      JUMP();                          \
+    }                                  \
+  } while (0)
+
+// pop two operands and jump if EXPR holds
+#define JCC(EXPR)                      \
+  do {                                 \
+    OPR();                             \
+    NEED(2);                           \
+    rhs = T;                           \
+    SHRINK();                          \
+    lhs = T;                           \
+    SHRINK();                          \
+    if (EXPR) {                        \
+      JUMP();                          \
+    }                                  \
+  } while (0)
+
+#define DO_INS_JLT     JCC(lhs <  rhs)
+#define DO_INS_JGE     JCC(lhs >= rhs)
+#define DO_INS_JEQ     JCC(lhs == rhs)
+#define DO_INS_JNE     JCC(lhs != rhs)
+#define DO_INS_JGT     JCC(lhs >  rhs)
+#define DO_INS_JLE     JCC(lhs <= rhs)
+
+// pick the entry of the table of JMPs following, the last is the default
+#define SWITCH_ENTRY()                 \
+  do {                                 \
+    OPR();                             \
+    NEED(1);                           \
+    lhs = T;                           \
+    SHRINK();                          \
+    if ((unsigned)lhs > (unsigned)opr) \
+      lhs = opr;                       \
+  } while (0)
+
+#if LOOP_CHECK
+// run the entry, which need not be a JMP in an unverified program
+#define DO_INS_SWITCH                  \
+  do {                                 \
+    SWITCH_ENTRY();                    \
+    if ((unsigned)(ip - vDec + lhs) >= (unsigned)vDecLen) { \
+      fatal("error: invalid switch table"); \
+    }                                  \
+    ip += lhs;                         \
+  } while (0)
+#else
+// the verifier proved the entries are JMPs so go straight to the target
+#define DO_INS_SWITCH                  \
+  do {                                 \
+    SWITCH_ENTRY();                    \
+    opr = ip[lhs].opr;                 \
+    JUMP();                            \
+  } while (0)
+#endif
+
+#define DO_INS_SCALL                   \
+  do {                                 \
+    OPR();                             \
+    SPILL();                           \
+    SAVE();                            \
+    vInsScall(opr);                    \
+    LOAD();                            \
+    FILL();                            \
+  } while (0)
+
+  FILL();
+  NEXT();
+
+ins_bad:
+  fatal("error: unknown instruction %u", ip[-1].opr);
+
+ins_badpc:
+  fatal("error: invalid vPC 0x%08x", ip[-1].opr);
+
+ins_deref:  DO_INS_DEREF;  NEXT();
+ins_drop:   DO_INS_DROP;   NEXT();
+ins_lognot: DO_TOK_LOGNOT; NEXT();
+ins_assign: DO_TOK_ASSIGN; NEXT();
+ins_addassign: DO_INS_ADDASSIGN; NEXT();
+ins_index:  DO_INS_INDEX;  NEXT();
+ins_storex: DO_INS_STOREX; NEXT();
+ins_select: DO_INS_SELECT; NEXT();
+ins_add:    DO_TOK_ADD;    NEXT();
+ins_sub:    DO_TOK_SUB;    NEXT();
+ins_mul:    DO_TOK_MUL;    NEXT();
+ins_div:    DO_TOK_DIV;    NEXT();
+ins_mod:    DO_TOK_MOD;    NEXT();
+ins_logor:  DO_TOK_LOGOR;  NEXT();
+ins_logand: DO_TOK_LOGAND; NEXT();
+ins_bitor:  DO_TOK_BITOR;  NEXT();
+ins_bitand: DO_TOK_BITAND; NEXT();
+ins_bitxor: DO_TOK_BITXOR; NEXT();
+ins_shl:    DO_TOK_SHL;    NEXT();
+ins_shr:    DO_TOK_SHR;    NEXT();
+ins_lt:     DO_TOK_LT;     NEXT();
+ins_gt:     DO_TOK_GT;     NEXT();
+ins_ltequ:  DO_TOK_LTEQU;  NEXT();
+ins_gtequ:  DO_TOK_GTEQU;  NEXT();
+ins_equ:    DO_TOK_EQU;    NEXT();
+ins_nequ:   DO_TOK_NEQU;   NEXT();
+ins_neg:    DO_INS_NEG;    NEXT();
+ins_dup:    DO_INS_DUP;    NEXT();
+ins_swap:   DO_INS_SWAP;   NEXT();
+ins_strtab: DO_INS_STRTAB; NEXT();
+ins_str:    DO_INS_STR;    NEXT();
+ins_const:  DO_INS_CONST;  NEXT();
+ins_call:   DO_INS_CALL;   NEXT();
+ins_tailcall: DO_INS_TAILCALL; NEXT();
+ins_getag:  DO_INS_GETAG;  NEXT();
+ins_getal:  DO_INS_GETAL;  NEXT();
+ins_getaa:  DO_INS_GETAA;  NEXT();
+ins_loadl:  DO_INS_LOADL;  NEXT();
+ins_storel: DO_INS_STOREL; NEXT();
+ins_loada:  DO_INS_LOADA;  NEXT();
+ins_storea: DO_INS_STOREA; NEXT();
+ins_loadg:  DO_INS_LOADG;  NEXT();
+ins_storeg: DO_INS_STOREG; NEXT();
+ins_incl:   DO_INS_INCL;   NEXT();
+ins_inca:   DO_INS_INCA;   NEXT();
+ins_incg:   DO_INS_INCG;   NEXT();
+ins_alloc:  DO_INS_ALLOC;  NEXT();
+ins_return: DO_INS_RETURN; NEXT();
+ins_jmp:    DO_INS_JMP;    NEXT();
+ins_jz:     DO_INS_JZ;     NEXT();
+ins_jnz:    DO_INS_JNZ;    NEXT();
+ins_jlt:    DO_INS_JLT;    NEXT();
+ins_jge:    DO_INS_JGE;    NEXT();
+ins_jeq:    DO_INS_JEQ;    NEXT();
+ins_jne:    DO_INS_JNE;    NEXT();
+ins_jgt:    DO_INS_JGT;    NEXT();
+ins_jle:    DO_INS_JLE;    NEXT();
+ins_switch: DO_INS_SWITCH; NEXT();
+ins_scall:  DO_INS_SCALL;  NEXT();
+
+#if LOOP_SUPER
+  // superinstructions, only the last part may transfer control
+#define SUPER2(A, B)                   \
+super_##A##_##B:                       \
+  DO_##A; ++ip;                        \
+  DO_##B; NEXT();
+#define SUPER3(A, B, C)                \
+super_##A##_##B##_##C:                 \
+  DO_##A; ++ip;                        \
+  DO_##B; ++ip;                        \
+  DO_##C; NEXT();
+#include "vsuper.h"
+#undef SUPER2
+#undef SUPER3
+#endif
+
+#undef SAVE
+#undef LOAD
+#undef T
+#undef SPILL
+#undef FILL
+#undef GROW
+#undef SHRINK
+#undef S
+#undef NEED
+#undef ROOM
+#undef ADDR
+#undef OPR
+#undef NEXT
+#undef JUMP
+#undef BINOP
+#undef VAR_LOAD
+#undef VAR_STORE
+#undef VAR_INC
+#undef JCC
+#undef CALL_LIMIT
+#undef CALL_HOT
+#undef RETURN_FRAME
+#undef DO_INS_DEREF
+#undef DO_INS_DROP
+#undef DO_TOK_LOGNOT
+#undef DO_TOK_ASSIGN
+#undef DO_INS_ADDASSIGN
+#undef DO_INS_INDEX
+#undef DO_INS_STOREX
+#undef DO_INS_SELECT
+#undef DO_TOK_ADD
+#undef DO_TOK_SUB
+#undef DO_TOK_MUL
+#undef DO_TOK_DIV
+#undef DO_TOK_MOD
+#undef DO_TOK_LOGOR
+#undef DO_TOK_LOGAND
+#undef DO_TOK_BITOR
+#undef DO_TOK_BITAND
+#undef DO_TOK_BITXOR
+#undef DO_TOK_SHL
+#undef DO_TOK_SHR
+#undef DO_TOK_LT
+#undef DO_TOK_GT
+#undef DO_TOK_LTEQU
+#undef DO_TOK_GTEQU
+#undef DO_TOK_EQU
+#undef DO_TOK_NEQU
+#undef DO_INS_NEG
+#undef DO_INS_DUP
+#undef DO_INS_SWAP
+#undef DO_INS_STRTAB
+#undef DO_INS_STR
+#undef DO_INS_CONST
+#undef DO_INS_CALL
+#undef TAIL_FRAME
+#undef DO_INS_TAILCALL
+#undef DO_INS_GETAG
+#undef DO_INS_GETAL
+#undef DO_INS_GETAA
+#undef DO_INS_LOADL
+#undef DO_INS_STOREL
+#undef DO_INS_LOADA
+#undef DO_INS_STOREA
+#undef DO_INS_LOADG
+#undef DO_INS_STOREG
+#undef DO_INS_INCL
+#undef DO_INS_INCA
+#undef DO_INS_INCG
+#undef DO_INS_ALLOC
+#undef DO_INS_RETURN
+#undef DO_INS_JMP
+#undef DO_INS_JZ
+#undef DO_INS_JNZ
+#undef DO_INS_JLT
+#undef DO_INS_JGE
+#undef DO_INS_JEQ
+#undef DO_INS_JNE
+#undef DO_INS_JGT
+#undef DO_INS_JLE
+#undef SWITCH_ENTRY
+#undef DO_INS_SWITCH
+#undef DO_INS_SCALL
+}
+
+#undef LOOP_NAME
+#undef LOOP_TOS
+#undef LOOP_CHECK
+#undef LOOP_HOT
+#undef LOOP_CALLS
+#undef LOOP_TRACE
+#undef LOOP_PROFILE
+#undef LOOP_SUPER
@@ -0,0 +1,34 @@
+// superinstructions
+//
+// each entry fuses a sequence of decoded instructions into one handler, see
+// vloop.h and vFuse.  only the last instruction of a sequence may transfer
+// control.  the longest entries come first as the first match wins.
+//
+// the table can be regenerated from a profiling run, 'exec -p' prints the
+// hottest fusable sequences of a program in this format.
+
+SUPER3(INS_STOREL, INS_DROP,   INS_LOADA)
+SUPER3(INS_CONST,  TOK_MOD,    INS_STOREL)
+SUPER3(INS_INCL,   INS_DROP,   INS_LOADL)
+SUPER3(INS_CONST,  INS_SCALL,  INS_DROP)
+SUPER3(INS_LOADA,  INS_CONST,  TOK_MOD)
+SUPER3(INS_LOADL,  INS_CONST,  TOK_ADD)
+SUPER3(INS_DROP,   INS_LOADL,  INS_LOADL)
+SUPER3(INS_STOREL, INS_LOADA,  INS_JLE)
+SUPER3(INS_LOADA,  INS_CONST,  TOK_SUB)
+SUPER3(INS_LOADL,  INS_INDEX,  INS_CONST)
+
+SUPER2(INS_LOADA,  INS_CONST)
+SUPER2(INS_LOADL,  INS_CONST)
+SUPER2(INS_STOREL, INS_DROP)
+SUPER2(INS_DROP,   INS_LOADL)
+SUPER2(INS_LOADL,  INS_LOADL)
+SUPER2(INS_LOADL,  TOK_ADD)
+SUPER2(INS_CONST,  TOK_MOD)
+SUPER2(INS_CONST,  INS_JNE)
+SUPER2(INS_DROP,   INS_LOADA)
+SUPER2(INS_INCL,   INS_DROP)
+SUPER2(INS_LOADL,  INS_INDEX)
+SUPER2(INS_LOADA,  INS_LOADL)
+SUPER2(INS_CONST,  INS_RETURN)
+SUPER2(INS_LOADA,  INS_JLE)